@@ -7,14 +7,10 @@
 
 #define MAX_LOADSTRING 100
 
+#include "Intersection.h"
 
-#define FPS 60
 #define TIMEOUT 1000/FPS
-#define DELTA_TIME 1.0f/FPS
-
-#include "Intersection.h"
 
-Intersection intersection;
 #define ONE_SECOND_TIMER 0x10FF
 #define FPS_TIMER 0x10FE
 
@@ -25,7 +21,7 @@ WCHAR szWindowClass[MAX_LOADSTRING];            // the main window class name
 
 // Forward declarations of functions included in this code module:
 ATOM                MyRegisterClass(HINSTANCE hInstance);
-BOOL                InitInstance(HINSTANCE, int);
+BOOL                InitInstance(HINSTANCE, int, Intersection*);
 LRESULT CALLBACK    WndProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK    About(HWND, UINT, WPARAM, LPARAM);
 
@@ -44,8 +40,12 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     LoadStringW(hInstance, IDC_ASSIGNMENT1, szWindowClass, MAX_LOADSTRING);
     MyRegisterClass(hInstance);
 
+    // The window only borrows the intersection, so it has to outlive the message loop below.
+    Intersection intersection;
+    intersection.track_recent_density(true);
+
     // Perform application initialization:
-    if (!InitInstance (hInstance, nCmdShow))
+    if (!InitInstance (hInstance, nCmdShow, &intersection))
     {
         return FALSE;
     }
@@ -96,22 +96,23 @@ ATOM MyRegisterClass(HINSTANCE hInstance)
 }
 
 //
-//   FUNCTION: InitInstance(HINSTANCE, int)
+//   FUNCTION: InitInstance(HINSTANCE, int, Intersection*)
 //
 //   PURPOSE: Saves instance handle and creates main window
 //
 //   COMMENTS:
 //
 //        In this function, we save the instance handle in a global variable and
-//        create and display the main program window.
+//        create and display the main program window. The intersection is handed
+//        to the window as its creation parameter.
 //
 
-BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
+BOOL InitInstance(HINSTANCE hInstance, int nCmdShow, Intersection* intersection)
 {
    hInst = hInstance; // Store instance handle in our global variable
 
    HWND hWnd = CreateWindow(szWindowClass, szTitle, WS_OVERLAPPEDWINDOW,
-      CW_USEDEFAULT, 0, CW_USEDEFAULT, 0, nullptr, nullptr, hInstance, nullptr);
+      CW_USEDEFAULT, 0, CW_USEDEFAULT, 0, nullptr, nullptr, hInstance, intersection);
 
    if (!hWnd)
    {
@@ -132,6 +133,7 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 //
 //  PURPOSE: Processes messages for the main window.
 //
+//  WM_CREATE   - store the intersection passed to CreateWindow
 //  WM_COMMAND  - process the application menu
 //  WM_PAINT    - Paint the main window
 //  WM_DESTROY  - post a quit message and return
@@ -143,8 +145,12 @@ constexpr static RECT invalidate{ 0, 0, 1200, 1200 };
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
     const auto wmId = LOWORD(wParam);
+    auto* intersection = reinterpret_cast<Intersection*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
     switch (message)
     {
+    case WM_CREATE:
+        SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(reinterpret_cast<LPCREATESTRUCT>(lParam)->lpCreateParams));
+        break;
     case WM_COMMAND:
         {
             // Parse the menu selections:
@@ -165,32 +171,34 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         switch (wmId)
         {
         case FPS_TIMER:
-            intersection.iterate_frame();
+            intersection->iterate_frame();
             InvalidateRect(hWnd, &invalidate, TRUE);
             break;
 
         case ONE_SECOND_TIMER:
-            intersection.iterate_trafficlight();
+            intersection->iterate_trafficlight();
             InvalidateRect(hWnd, &invalidate, TRUE);
             break;
         }
         break;
     case WM_KEYDOWN:
         if (wParam == VK_UP)
-            intersection.increase_probability_north();
+            intersection->increase_probability_north_south();
         else if (wParam == VK_DOWN)
-            intersection.decrease_probability_north();
+            intersection->decrease_probability_north_south();
         if (wParam == VK_RIGHT)
-            intersection.increase_probability_west();
+            intersection->increase_probability_east_west();
         else if (wParam == VK_LEFT)
-            intersection.decrease_probability_west();
+            intersection->decrease_probability_east_west();
+        if (wParam == 'D')
+            intersection->cycle_detail_limit();
         break;
     case WM_PAINT:
         {
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hWnd, &ps);
             // TODO: Add any drawing code that uses hdc here...
-            intersection.draw(hdc);
+            intersection->draw(hdc);
 
             EndPaint(hWnd, &ps);
         }
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <windows.h>
+
+#include <vector>
+
+struct CellTransmissionParameters
+{
+	// Free speed and jam density match the microscopic model: cars cruise at 250 px/s and queue 120 px apart.
+	// Capacity does not. A queue in the microscopic model discharges about 1.46 cars per second of green, but a
+	// cell one free flow step long can pass a backward wave no faster than the free speed, which caps the
+	// capacity of these roads at free_speed * jam_density / 2, about 1.04 vehicles per second. A platoon
+	// leaving an intersection faster than capacity waits at the road's entrance and spreads out along it.
+	float free_speed{ 250.0f };
+	float jam_density{ 1.0f / 120.0f };
+	float capacity{ 1.0f };
+	float time_step{ 1.0f };
+};
+
+// A road between two microscopic zones, modelled with Daganzo's cell transmission model: the road is cut
+// into cells one free flow step long, each holding a (fractional) number of vehicles, and every step moves
+// as many vehicles between neighbouring cells as the upstream one can send and the downstream one can
+// receive under a triangular fundamental diagram. Work per step is proportional to the number of cells,
+// however many vehicles are on the road.
+class CellTransmissionRoad
+{
+public:
+	CellTransmissionRoad(std::size_t cells, CellTransmissionParameters parameters = {})
+		: m_parameters(parameters)
+		, m_vehicles(cells, 0.0f)
+		, m_flows(cells + 1, 0.0f)
+	{
+		const auto cell_length = m_parameters.free_speed * m_parameters.time_step;
+		m_max_flow = m_parameters.capacity * m_parameters.time_step;
+		m_max_vehicles = m_parameters.jam_density * cell_length;
+		// Backward wave speed relative to free speed, from the triangle through capacity and jam density. A
+		// faster wave would overfill a cell within a step, so beyond free_speed * jam_density / 2 the flow is
+		// limited by the wave rather than by capacity.
+		const auto critical_density = m_parameters.capacity / m_parameters.free_speed;
+		m_wave_ratio = critical_density < m_parameters.jam_density / 2.0f
+			? critical_density / (m_parameters.jam_density - critical_density)
+			: 1.0f;
+	}
+
+	std::size_t cells() const { return m_vehicles.size(); }
+	float length() const { return cells() * m_parameters.free_speed * m_parameters.time_step; }
+	const std::vector<float>& vehicles() const { return m_vehicles; }
+
+	// Vehicles on the road, plus those waiting at the entrance because the first cell was full.
+	float total() const
+	{
+		auto total = m_entry_queue;
+		for (const auto vehicles : m_vehicles)
+			total += vehicles;
+		return total;
+	}
+
+	// Vehicles handed over by the upstream zone. Whatever the first cell cannot take waits at the entrance.
+	void enter(float vehicles) { m_entry_queue += vehicles; }
+
+	// Advances one time step and returns the vehicles leaving the downstream end, which is at most receiving.
+	float step(float receiving)
+	{
+		const auto last = m_vehicles.size() - 1;
+
+		m_flows[0] = min(m_entry_queue, receiving_of(0));
+		for (std::size_t cell = 1; cell <= last; cell++)
+			m_flows[cell] = min(sending_of(cell - 1), receiving_of(cell));
+		m_flows[last + 1] = min(sending_of(last), receiving);
+
+		m_entry_queue -= m_flows[0];
+		for (std::size_t cell = 0; cell <= last; cell++)
+			m_vehicles[cell] += m_flows[cell] - m_flows[cell + 1];
+
+		return m_flows[last + 1];
+	}
+
+private:
+	float sending_of(std::size_t cell) const { return min(m_vehicles[cell], m_max_flow); }
+	float receiving_of(std::size_t cell) const { return min(m_max_flow, m_wave_ratio * (m_max_vehicles - m_vehicles[cell])); }
+
+	CellTransmissionParameters m_parameters;
+
+	std::vector<float> m_vehicles;
+	std::vector<float> m_flows;
+	float m_entry_queue{ 0.0f };
+
+	float m_max_flow{ 0.0f };
+	float m_max_vehicles{ 0.0f };
+	float m_wave_ratio{ 1.0f };
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Intersection.h"
+#include "Statistics.h"
+
+// Everything that may differ between the two sides of a comparison.
+struct Scenario
+{
+	int probability[4]{ 250, 250, 250, 250 };
+	SignalTiming east_west;
+	SignalTiming north_south;
+
+	void apply(Intersection& intersection) const
+	{
+		for (int approach = 0; approach < 4; approach++)
+			intersection.set_probability((Direction)approach, probability[approach]);
+		intersection.set_timing(Orientation::HORIZONTAL, east_west);
+		intersection.set_timing(Orientation::VERTICAL, north_south);
+	}
+};
+
+struct ComparisonOptions
+{
+	std::size_t replications{ 10 };
+	std::size_t seconds{ 3600 };
+	unsigned int seed{ 0 };
+	// Runs every replication a second time on the mirrored streams and averages the pair into one sample.
+	bool antithetic{ false };
+};
+
+struct ComparisonResult
+{
+	// Mean delay per car in each scenario, and of b minus a replication by replication.
+	ConfidenceInterval a;
+	ConfidenceInterval b;
+	ConfidenceInterval difference;
+};
+
+// Mean delay over the cars completed after warm_up_time.
+double mean_delay_after(const Intersection& intersection, double warm_up_time)
+{
+	const auto& delays = intersection.delays();
+	const auto& times = intersection.delay_times();
+
+	auto sum = 0.0;
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < delays.size(); i++) {
+		if (times[i] <= warm_up_time)
+			continue;
+		sum += delays[i];
+		count++;
+	}
+	return count == 0 ? 0.0 : sum / count;
+}
+
+// Runs both scenarios on common random numbers, replication by replication, and reports the paired
+// difference. The warm-up is found by MSER-5 in each run, and the longer of the two is cut from both so
+// the pair stays comparable.
+ComparisonResult compare_scenarios(const Scenario& a, const Scenario& b, const ComparisonOptions& options)
+{
+	const auto runs = options.antithetic ? 2 : 1;
+
+	std::vector<double> samples_a;
+	std::vector<double> samples_b;
+	std::vector<double> differences;
+
+	for (std::size_t replication = 0; replication < options.replications; replication++) {
+		std::seed_seq sequence{ options.seed, (unsigned int)replication };
+		std::uint32_t replication_seed;
+		sequence.generate(&replication_seed, &replication_seed + 1);
+
+		auto mean_a = 0.0;
+		auto mean_b = 0.0;
+		for (int run = 0; run < runs; run++) {
+			Intersection first(replication_seed, run == 1);
+			Intersection second(replication_seed, run == 1);
+			a.apply(first);
+			b.apply(second);
+			first.record_delays(true);
+			second.record_delays(true);
+			first.simulate(options.seconds);
+			second.simulate(options.seconds);
+
+			const auto truncation_a = mser5_truncation(first.delays());
+			const auto truncation_b = mser5_truncation(second.delays());
+			const auto warm_up_a = truncation_a == 0 ? 0.0 : first.delay_times()[truncation_a - 1];
+			const auto warm_up_b = truncation_b == 0 ? 0.0 : second.delay_times()[truncation_b - 1];
+			const auto warm_up = max(warm_up_a, warm_up_b);
+
+			mean_a += mean_delay_after(first, warm_up) / runs;
+			mean_b += mean_delay_after(second, warm_up) / runs;
+		}
+
+		samples_a.push_back(mean_a);
+		samples_b.push_back(mean_b);
+		differences.push_back(mean_b - mean_a);
+	}
+
+	ComparisonResult result;
+	result.a = confidence_interval(samples_a.data(), samples_a.size());
+	result.b = confidence_interval(samples_b.data(), samples_b.size());
+	result.difference = confidence_interval(differences.data(), differences.size());
+	return result;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <windows.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Occupancy and speed of the cars over a rectangle, binned into square cells and weighted by simulated time.
+// The arrays are sized once up front, so binning a step never allocates and costs a few samples per car.
+// Given a half life, older steps weigh exponentially less, so the grid follows what is on the road lately
+// rather than averaging the whole run. The decay is applied lazily by weighting new samples ever more heavily,
+// so it costs nothing per step until the weights are renormalised once in a long while.
+class DensityGrid
+{
+public:
+	DensityGrid() = default;
+	DensityGrid(RECT bounds, LONG cell_size, double half_life = 0.0)
+		: m_bounds(bounds)
+		, m_cell_size(max(cell_size, 1L))
+		, m_columns((std::size_t)((bounds.right - bounds.left + m_cell_size - 1) / m_cell_size))
+		, m_rows((std::size_t)((bounds.bottom - bounds.top + m_cell_size - 1) / m_cell_size))
+		, m_half_life(max(half_life, 0.0))
+		, m_car_time(m_columns * m_rows, 0.0)
+		, m_speed_time(m_columns * m_rows, 0.0)
+	{
+	}
+
+	RECT bounds() const { return m_bounds; }
+	LONG cell_size() const { return m_cell_size; }
+	std::size_t columns() const { return m_columns; }
+	std::size_t rows() const { return m_rows; }
+
+	// Simulated seconds accumulated since the grid was last cleared. With a half life, the effective length
+	// of the window instead, which approaches half_life / ln 2.
+	double time() const { return m_time / m_weight; }
+	double half_life() const { return m_half_life; }
+
+	// Mean number of cars with their centre in the cell.
+	double occupancy(std::size_t column, std::size_t row) const
+	{
+		return m_time > 0.0 ? m_car_time[row * m_columns + column] / m_time : 0.0;
+	}
+
+	// Mean speed of the cars seen in the cell, or zero if none was.
+	double mean_speed(std::size_t column, std::size_t row) const
+	{
+		const auto car_time = m_car_time[row * m_columns + column];
+		return car_time > 0.0 ? m_speed_time[row * m_columns + column] / car_time : 0.0;
+	}
+
+	void clear()
+	{
+		std::fill(m_car_time.begin(), m_car_time.end(), 0.0);
+		std::fill(m_speed_time.begin(), m_speed_time.end(), 0.0);
+		m_time = 0.0;
+		m_weight = 1.0;
+	}
+
+	// Counts a step of time seconds, whether or not any car was binned during it. Call it before adding the
+	// cars' movement over the step, so that the step is weighted as of its end.
+	void elapse(double time)
+	{
+		if (m_half_life > 0.0) {
+			m_weight *= exp2(time / m_half_life);
+			if (m_weight > renormalise_weight)
+				renormalise();
+		}
+		m_time += time * m_weight;
+	}
+
+	// Spreads a car's time over the cells along the straight line it moved on during a step, at least one
+	// sample per cell it crossed. Long steps through a turn cut the corner, which is well inside a cell or two.
+	void add(float x0, float y0, float x1, float y1, float time)
+	{
+		if (time <= 0.0f)
+			return;
+
+		const auto length = hypotf(x1 - x0, y1 - y0);
+		const auto speed = length / time;
+		const auto samples = 1 + (int)(length / m_cell_size);
+		for (int sample = 0; sample < samples; sample++) {
+			const auto t = (sample + 0.5f) / samples;
+			bin(x0 + (x1 - x0) * t, y0 + (y1 - y0) * t, speed, time / samples);
+		}
+	}
+
+	// Fills every visited cell, brighter the more it was occupied and from red for standing traffic to green
+	// for traffic at full_speed.
+	void draw(const HDC context, float full_speed) const
+	{
+		const auto brush = (HBRUSH)GetStockObject(DC_BRUSH);
+		for (std::size_t row = 0; row < m_rows; row++) {
+			for (std::size_t column = 0; column < m_columns; column++) {
+				const auto occupied = min(occupancy(column, row), 1.0);
+				if (occupied <= 0.0)
+					continue;
+
+				const auto fast = min(mean_speed(column, row) / full_speed, 1.0);
+				const auto intensity = 64.0 + 191.0 * occupied;
+				SetDCBrushColor(context, RGB((BYTE)(intensity * (1.0 - fast)), (BYTE)(intensity * fast), 0));
+
+				const auto left = m_bounds.left + (LONG)column * m_cell_size;
+				const auto top = m_bounds.top + (LONG)row * m_cell_size;
+				const RECT cell{ left, top, min(left + m_cell_size, m_bounds.right), min(top + m_cell_size, m_bounds.bottom) };
+				FillRect(context, &cell, brush);
+			}
+		}
+	}
+
+private:
+	void renormalise()
+	{
+		for (auto& car_time : m_car_time)
+			car_time /= m_weight;
+		for (auto& speed_time : m_speed_time)
+			speed_time /= m_weight;
+		m_time /= m_weight;
+		m_weight = 1.0;
+	}
+
+	void bin(float x, float y, float speed, float time)
+	{
+		const auto column = (LONG)floorf((x - m_bounds.left) / m_cell_size);
+		const auto row = (LONG)floorf((y - m_bounds.top) / m_cell_size);
+		if (column < 0 || row < 0 || (std::size_t)column >= m_columns || (std::size_t)row >= m_rows)
+			return;
+
+		const auto cell = (std::size_t)row * m_columns + (std::size_t)column;
+		m_car_time[cell] += time * m_weight;
+		m_speed_time[cell] += (double)speed * time * m_weight;
+	}
+
+	constexpr static double renormalise_weight = 1e100;
+
+	RECT m_bounds{ 0, 0, 0, 0 };
+	LONG m_cell_size{ 1 };
+	std::size_t m_columns{ 0 };
+	std::size_t m_rows{ 0 };
+
+	double m_half_life{ 0.0 };
+
+	// Car-seconds, and speed times car-seconds, per cell in rows from the top. All are scaled by the weight of
+	// the latest step.
+	std::vector<double> m_car_time;
+	std::vector<double> m_speed_time;
+	double m_time{ 0.0 };
+	double m_weight{ 1.0 };
+};
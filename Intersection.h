@@ -1,24 +1,33 @@
 #pragma once
 
 #include "TrafficLight.h"
+#include "RandomStream.h"
+#include "DensityGrid.h"
 
 #include <windows.h>
 
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <cstdint>
+
+#define FPS 60
 
 template<typename T>
 class Vector2
 {
 public:
-	Vector2(T x, T y) : m_x(x), m_y(y) {}
-	Vector2(const Vector2& other) = default;
-	Vector2(Vector2&& other) = default;
+	constexpr Vector2(T x, T y) : m_x(x), m_y(y) {}
+	constexpr Vector2(const Vector2& other) = default;
+	constexpr Vector2(Vector2&& other) = default;
 	
 
 public:
-	T x() const { return m_x; }
-	T y() const { return m_y; }
+	constexpr T x() const { return m_x; }
+	constexpr T y() const { return m_y; }
 
 	void set_x(const T& other) { m_x = other; }
 	void set_y(const T& other) { m_y = other; }
@@ -26,7 +35,7 @@ public:
 	inline void operator=(const Vector2<T>& other) { m_x = other.m_x; m_y = other.m_y; };
 	inline void operator=(Vector2<T>& other) { m_x = other.m_x; m_y = other.m_y; };
 
-	inline void operator==(const Vector2<T>& other) { return m_x == other.m_x && m_y == other.m_y; }
+	inline bool operator==(const Vector2<T>& other) const { return m_x == other.m_x && m_y == other.m_y; }
 
 	inline void operator+=(const Vector2<T>& other)
 	{
@@ -40,9 +49,19 @@ public:
 		m_y = other.m_y * m_y;
 	}
 
-	inline Vector2 operator+(const Vector2<T>& other)
+	constexpr Vector2 operator+(const Vector2<T>& other) const
+	{
+		return { other.m_x + m_x, other.m_y + m_y };
+	}
+
+	constexpr Vector2 operator-(const Vector2<T>& other) const
+	{
+		return { m_x - other.m_x, m_y - other.m_y };
+	}
+
+	constexpr Vector2 operator*(const T& scalar) const
 	{
-		return { other.x + x, other.y + y };
+		return { m_x * scalar, m_y * scalar };
 	}
 
 private:
@@ -56,84 +75,212 @@ enum class Orientation : int {
 	HORIZONTAL = 1
 };
 
+// The side of the intersection an approach (or a road arm) is attached to.
+enum class Direction : int {
+	NORTH = 0,
+	EAST = 1,
+	SOUTH = 2,
+	WEST = 3
+};
+
+enum class Movement : int {
+	LEFT = 0,
+	THROUGH = 1,
+	RIGHT = 2
+};
+
+constexpr Orientation axis_of(const Direction direction)
+{
+	return (direction == Direction::NORTH || direction == Direction::SOUTH) ? Orientation::VERTICAL : Orientation::HORIZONTAL;
+}
+
+// Unit vector of travel for a car entering from the given approach (screen coordinates, y grows downwards).
+constexpr Vector2<float> heading_of(const Direction approach)
+{
+	switch (approach)
+	{
+	case Direction::NORTH: return { 0.0f, 1.0f };
+	case Direction::EAST: return { -1.0f, 0.0f };
+	case Direction::SOUTH: return { 0.0f, -1.0f };
+	case Direction::WEST: return { 1.0f, 0.0f };
+	}
+	return { 0.0f, 0.0f };
+}
+
+// Traffic keeps right, so the right hand side of a heading is also the side its lane lies on.
+constexpr Vector2<float> right_of(const Vector2<float> heading) { return { -heading.y(), heading.x() }; }
+constexpr Vector2<float> left_of(const Vector2<float> heading) { return { heading.y(), -heading.x() }; }
+
+constexpr Direction opposite_of(const Direction side)
+{
+	return (Direction)(((int)side + 2) % 4);
+}
 
-template<Orientation orientation>
+// The side of the intersection a car leaves by.
+constexpr Direction exit_side_of(const Direction approach, const Movement movement)
+{
+	switch (movement)
+	{
+	case Movement::LEFT: return (Direction)(((int)approach + 1) % 4);
+	case Movement::RIGHT: return (Direction)(((int)approach + 3) % 4);
+	case Movement::THROUGH: break;
+	}
+	return opposite_of(approach);
+}
+
+constexpr Vector2<float> exit_heading_of(const Direction approach, const Movement movement)
+{
+	switch (movement)
+	{
+	case Movement::LEFT: return left_of(heading_of(approach));
+	case Movement::RIGHT: return right_of(heading_of(approach));
+	case Movement::THROUGH: break;
+	}
+	return heading_of(approach);
+}
+
+// A car only knows the distance it has travelled along its path. The approach is fixed at compile time and
+// the movement is resolved into an exit heading and a turn distance on construction, so advance() has no
+// branching on either.
+template<Direction approach>
 class Car {
 
 public:
-	
-	Car(Vector2<float> position) : m_position(position) {
-		m_color = rand();
-		brush = CreateSolidBrush(m_color);
-		if constexpr (orientation == Orientation::HORIZONTAL) m_velocity = { 5.0f, 0.0f };
-		if constexpr (orientation == Orientation::VERTICAL) m_velocity = { 0.0F, 5.0f };
+	constexpr static Vector2<float> heading = heading_of(approach);
+	constexpr static float max_speed = 250.0f;
+	constexpr static float length = 40.0f;
+	constexpr static float width = 20.0f;
+	constexpr static float acceleration_rate = 500.0f;
+	constexpr static float braking_rate = 450.0f;
+
+	Car(Vector2<float> position, Movement movement, float turn_distance, float exit_distance, COLORREF color)
+		: m_position(position)
+		, m_exit_heading(exit_heading_of(approach, movement))
+		, m_movement(movement)
+		, m_turn_distance(turn_distance)
+		, m_exit_distance(exit_distance)
+		, m_color(color)
+	{
 	}
 
-	~Car()
+	COLORREF color() const { return m_color; }
+
+	// Picks the acceleration for the coming step. It stays constant until the car reaches full speed or
+	// comes to a halt, which advance() and time_to_cover() account for exactly.
+	void decide(bool should_drive)
 	{
-		DeleteObject(brush);
+		m_driving = should_drive;
+		if (should_drive)
+			m_acceleration = m_speed < max_speed ? acceleration_rate : 0.0f;
+		else
+			m_acceleration = m_speed > 0.0f ? -braking_rate : 0.0f;
 	}
 
-	COLORREF color() const { return m_color; }
+	// Seconds a car starting from a standstill needs to cover distance.
+	static float time_from_rest(float distance)
+	{
+		const auto accelerating = max_speed / acceleration_rate;
+		const auto accelerating_distance = 0.5f * max_speed * accelerating;
+		if (distance <= accelerating_distance)
+			return sqrtf(2.0f * max(distance, 0.0f) / acceleration_rate);
+		return accelerating + (distance - accelerating_distance) / max_speed;
+	}
 
-	void update(bool should_drive)
+	// Seconds until the car has covered distance more, if it sticks to its current decision. Never, for a
+	// point already behind it or one it stops short of.
+	float time_to_cover(float distance) const
 	{
-		auto velocity = 0.0f;
-		auto acceleration = 0.0f;
-		if constexpr (orientation == Orientation::HORIZONTAL) velocity		= m_velocity.x();		else velocity		= m_velocity.y();
-		if constexpr (orientation == Orientation::HORIZONTAL) acceleration	= m_acceleration.x();	else acceleration	= m_acceleration.y();
-
-		if (should_drive && velocity < 250.0f)
-			acceleration = 500.0f;
-		else if (!should_drive && velocity > 0.0f)
-			acceleration = -450.0f;
-		else if (!should_drive && velocity < 0.0f)
-		{
-			velocity = 0;
-			acceleration = 0.0f;
-		}
-		else {
-			acceleration = 0.0f;
+		if (distance < 0.0f)
+			return INFINITY;
+
+		if (m_driving) {
+			const auto accelerating = (max_speed - m_speed) / acceleration_rate;
+			const auto accelerating_distance = m_speed * accelerating + 0.5f * acceleration_rate * accelerating * accelerating;
+			if (distance <= accelerating_distance)
+				return (sqrtf(m_speed * m_speed + 2.0f * acceleration_rate * distance) - m_speed) / acceleration_rate;
+			return accelerating + (distance - accelerating_distance) / max_speed;
 		}
-		velocity += acceleration * DELTA_TIME;
-		if constexpr (orientation == Orientation::HORIZONTAL)	{ m_position += { velocity* DELTA_TIME, 0.0f }; m_velocity = { velocity, 0.0f }; }
-		else													{ m_position += { 0.0f, velocity* DELTA_TIME }; m_velocity = { 0.0f, velocity }; }
 
+		const auto stopping_distance = m_speed * m_speed / (2.0f * braking_rate);
+		if (distance >= stopping_distance)
+			return INFINITY;
+		return (m_speed - sqrtf(m_speed * m_speed - 2.0f * braking_rate * distance)) / braking_rate;
+	}
+
+	// Moves the car for time seconds, integrating the decided acceleration exactly up to the moment the car
+	// reaches full speed or stops, and at constant speed after that.
+	void advance(float time)
+	{
+		const auto limit = m_driving ? max_speed : 0.0f;
+		const auto changing = m_acceleration == 0.0f ? 0.0f : min((limit - m_speed) / m_acceleration, time);
+		auto step = m_speed * changing + 0.5f * m_acceleration * changing * changing;
+		m_speed = changing < time ? limit : m_speed + m_acceleration * changing;
+		step += m_speed * (time - changing);
+		if (m_speed == limit)
+			m_acceleration = 0.0f;
+
+		// Split the step at the turn point instead of branching on which leg of the path the car is on.
+		const auto before_turn = min(max(m_turn_distance - m_distance, 0.0f), step);
+		m_position += heading * before_turn + m_exit_heading * (step - before_turn);
+		m_distance += step;
+		m_time += time;
 	}
 
 	void draw(const HDC context) const
 	{
-		const SIZE size = (orientation == Orientation::HORIZONTAL) ? SIZE { 40, 20 } : SIZE { 20, 40 };
-		const auto a = RECT{ (LONG)roundf(m_position.x()), (LONG)roundf(m_position.y()), (LONG)floorf(m_position.x()) + size.cx, (LONG)floorf(m_position.y()) + size.cy };
-		FillRect(context, &a, brush);
+		const auto& current_heading = m_distance > m_turn_distance ? m_exit_heading : heading;
+		const auto size = current_heading.x() != 0.0f ? Vector2<float>{ length, width } : Vector2<float>{ width, length };
+		const auto top_left = m_position - size * 0.5f;
+		const auto a = RECT{ (LONG)roundf(top_left.x()), (LONG)roundf(top_left.y()), (LONG)roundf(top_left.x() + size.x()), (LONG)roundf(top_left.y() + size.y()) };
+		SetDCBrushColor(context, m_color);
+		FillRect(context, &a, (HBRUSH)GetStockObject(DC_BRUSH));
 	}
 
+	// Centre of the car.
 	Vector2<float> position() const { return m_position; }
-	Vector2<float> velocity() const { return m_velocity; }
-	Vector2<float> acceleration() const { return m_acceleration; }
+	Vector2<float> velocity() const { return (m_distance < m_turn_distance ? heading : m_exit_heading) * m_speed; }
+	float speed() const { return m_speed; }
+	float acceleration() const { return m_acceleration; }
+	float distance() const { return m_distance; }
+	float turn_distance() const { return m_turn_distance; }
+	float exit_distance() const { return m_exit_distance; }
+	bool driving() const { return m_driving; }
+	Movement movement() const { return m_movement; }
+
+	// Seconds since the car spawned, and how much longer that took than driving the path at full speed.
+	float time() const { return m_time; }
+	float delay() const { return m_time - m_distance / max_speed; }
+
+	bool finished() const { return m_distance > m_exit_distance; }
+
+	// Simulated time at which a left turner came up to the point where it yields, or infinity before then.
+	double yielding_since() const { return m_yielding_since; }
+	void start_yielding(double time) { m_yielding_since = time; }
 
 private:
 
 	Vector2<float> m_position{ 0.0f, 0.0f };
-	Vector2<float> m_velocity{ 0.0f, 0.0f };
-	Vector2<float> m_acceleration{ 0.0f, 0.0f };
+	Vector2<float> m_exit_heading{ 0.0f, 0.0f };
+	Movement m_movement;
+
+	float m_speed{ 5.0f };
+	float m_acceleration{ 0.0f };
+	bool m_driving{ true };
+	float m_distance{ 0.0f };
+	float m_time{ 0.0f };
+	float m_turn_distance;
+	float m_exit_distance;
+	double m_yielding_since{ INFINITY };
 	
 	COLORREF m_color;
-	HBRUSH brush;
 };
 
-template<Orientation orientation>
+// One arm of the intersection. The size is given as { width, length } regardless of the side it is on.
+template<Direction side>
 class Road {
 public:
 
-	Road();
-
-	~Road()
-	{
-		DeleteObject(background_brush);
-		DeleteObject(lane_brush);
-	}
-
+	Road() = default;
 
 	void draw(const HDC context) const;
 
@@ -147,151 +294,597 @@ private:
 	POINT m_position{ 0, 0 };
 	SIZE m_size{ 120, 400 };
 
-	HBRUSH background_brush;
-	HBRUSH lane_brush;
-
 	constexpr static COLORREF background_color = 0x00101010;
 	constexpr static COLORREF lane_color = 0x00AFAFAF;
 	
 };
 
-template<Orientation orientation>
-Road<orientation>::Road()
-{
-	background_brush = CreateSolidBrush(background_color);
-	lane_brush = CreateSolidBrush(lane_color);
-}
-
-template<Orientation orientation>
-void Road<orientation>::draw(const HDC context) const
+template<Direction side>
+void Road<side>::draw(const HDC context) const
 {
 	RECT road_rect;
-	if constexpr (orientation == Orientation::VERTICAL)
-		 road_rect = { m_position.x, m_position.y, m_position.x + m_size.cx, m_position.y + m_size.cy };
-	if constexpr (orientation == Orientation::HORIZONTAL)
+	RECT lane_rect;
+	if constexpr (axis_of(side) == Orientation::VERTICAL) {
+		road_rect = { m_position.x, m_position.y, m_position.x + m_size.cx, m_position.y + m_size.cy };
+		lane_rect = { m_position.x + m_size.cx / 2 - 1, m_position.y, m_position.x + m_size.cx / 2 + 1, m_position.y + m_size.cy };
+	}
+	if constexpr (axis_of(side) == Orientation::HORIZONTAL) {
 		road_rect = { m_position.x, m_position.y, m_position.x + m_size.cy, m_position.y + m_size.cx };
+		lane_rect = { m_position.x, m_position.y + m_size.cx / 2 - 1, m_position.x + m_size.cy, m_position.y + m_size.cx / 2 + 1 };
+	}
 	
-	FillRect(context, &road_rect, background_brush);
+	const auto brush = (HBRUSH)GetStockObject(DC_BRUSH);
+	SetDCBrushColor(context, background_color);
+	FillRect(context, &road_rect, brush);
+	SetDCBrushColor(context, lane_color);
+	FillRect(context, &lane_rect, brush);
 }
 
+// Seconds spent in each phase of a signal cycle, for one pair of opposing approaches.
+struct SignalTiming
+{
+	std::size_t driving{ 9 };
+	std::size_t stopping{ 2 };
+	std::size_t starting{ 2 };
+};
+
+struct ApproachMetrics
+{
+	std::size_t spawned{ 0 };
+	std::size_t completed{ 0 };
+	double travel_time{ 0.0 };
+	double delay{ 0.0 };
+};
+
+// Owns all of its state, including the random streams, so independent instances can be stepped concurrently.
 class Intersection
 {
 public:
-	Intersection();
-
-	~Intersection()
-	{
-		DeleteObject(background_brush);
-	}
+	Intersection(unsigned int seed = std::random_device{}(), bool antithetic = false);
 
 	void draw(const HDC context) const;
 
 	void iterate_trafficlight();
+	// Advances the cars by one fixed frame, for the window timer.
 	void iterate_frame();
 
-	void increase_probability_north()
+	// Advances the simulation by whole seconds, switching the lights once a second like the window timers do.
+	// In between, steps run from one event to the next: an arrival, or a car reaching a point where its
+	// decision to drive or brake may change. Free flowing and waiting traffic is crossed in a few long steps,
+	// and no step is shorter than half a frame.
+	void simulate(std::size_t seconds);
+
+	// Arrivals and the placement of new cars draw from separate streams per approach, so two intersections
+	// seeded alike see the same arrivals even when their demand or signal timing differ.
+	void seed(unsigned int seed, bool antithetic = false);
+
+	// One car spawns per this many frames on average, or none at all for 0.
+	int probability(Direction approach) const { return m_probability[(int)approach]; }
+	void set_probability(Direction approach, int probability);
+
+	SignalTiming timing(Orientation axis) const { return axis == Orientation::HORIZONTAL ? east_west_timing : north_south_timing; }
+	void set_timing(Orientation axis, SignalTiming timing) { (axis == Orientation::HORIZONTAL ? east_west_timing : north_south_timing) = timing; }
+
+	// Simulated seconds.
+	double time() const { return m_time; }
+	const ApproachMetrics& metrics(Direction approach) const { return m_metrics[(int)approach]; }
+	std::size_t cars(Direction approach) const;
+	// Cars that are standing still short of the stop line.
+	std::size_t queued(Direction approach) const;
+
+	// Cars handed over by whatever feeds this approach from outside, such as the road from a neighbouring
+	// intersection. They wait off the road until the entrance is clear.
+	void inject(Direction approach, std::size_t count) { m_pending[(int)approach] += count; }
+	std::size_t pending(Direction approach) const { return m_pending[(int)approach]; }
+
+	// Cars that left by the given side since the last call.
+	std::size_t take_departures(Direction side) { return std::exchange(m_departures[(int)side], 0); }
+
+	// Optionally keeps the delay of every completed car, in order of completion, along with the time it
+	// completed at. Used to detect the end of the warm-up and to decide when a run has converged.
+	void record_delays(bool record) { m_record_delays = record; }
+	void clear_delays() { m_delays.clear(); m_delay_times.clear(); }
+	const std::vector<double>& delays() const { return m_delays; }
+	const std::vector<double>& delay_times() const { return m_delay_times; }
+
+	// Occupancy and mean speed over the roads, accumulated every step since construction or the last clear.
+	const DensityGrid& density() const { return m_density; }
+	void clear_density() { m_density.clear(); }
+
+	// Optionally keeps a second grid that fades with a half life of a few seconds, so draw() can show the
+	// traffic as it is now rather than averaged over the run. Only a window needs it, so it is off by default
+	// and headless runs bin every car into the one grid.
+	void track_recent_density(bool track);
+
+	// Beyond this many cars, draw() shows the density grid in place of the individual cars: the recent one if
+	// it is tracked, otherwise the one for the whole run. The limit starts at the road capacity, beyond which
+	// the cars are mostly stacked up where they spawn.
+	std::size_t detail_limit() const { return m_detail_limit; }
+	void set_detail_limit(std::size_t limit) { m_detail_limit = limit; }
+	// Steps the limit from the road capacity to always drawing the grid, then to always drawing the cars.
+	void cycle_detail_limit();
+
+	// Cars the roads hold with every lane queued from end to end.
+	std::size_t road_capacity() const;
+
+	void increase_probability_north_south()
 	{
-		probability_north = max(probability_north - 1, 1);
+		adjust_probability(Orientation::VERTICAL, -1);
 	}
-	void decrease_probability_north()
+	void decrease_probability_north_south()
 	{
-		probability_north++;
+		adjust_probability(Orientation::VERTICAL, 1);
 	}
-	void increase_probability_west()
+	void increase_probability_east_west()
 	{
-		probability_west = max(probability_west - 1, 1);
+		adjust_probability(Orientation::HORIZONTAL, -1);
 
 	}
-	void decrease_probability_west()
+	void decrease_probability_east_west()
 	{
-		probability_west++;
+		adjust_probability(Orientation::HORIZONTAL, 1);
 	}
 
 private:
 
-	int probability_north = 150;
-	int probability_west = 150;
+	void adjust_probability(Orientation axis, int change);
+
+
+	template<Direction approach>
+	using Cars = std::vector<std::shared_ptr<Car<approach>>>;
+
+	// Draws the frame the next car arrives on, counting from the one starting at from.
+	void schedule_arrival(Direction approach, double from);
+
+	// Spawns due cars and lets every car decide whether to drive, then returns how long the decisions are
+	// certain to hold.
+	double prepare();
+	void advance_to(double time);
+
+	template<Direction approach>
+	void spawn_car(Cars<approach>& cars);
+
+	template<Direction approach>
+	double decide_cars(Cars<approach>& cars);
+
+	template<Direction approach>
+	void advance_cars(Cars<approach>& cars, float time);
+
+	template<Direction approach>
+	bool can_drive() const;
+
+	// Where a left turner waits for a gap, short of the opposing lane.
+	template<Direction approach>
+	float yield_distance(const Car<approach>& car) const;
+
+	// Whether the left turner can start across the opposing lane now. Lowers bound to how long the answer is
+	// certain to hold.
+	template<Direction approach>
+	bool left_turn_clear(const Car<approach>& car, double& bound) const;
+
+	template<Direction approach>
+	const Cars<approach>& cars_of() const;
+
+	template<Direction approach>
+	std::size_t queued_of() const;
+
+	void set_lights(TrafficLight::State east_west, TrafficLight::State north_south);
+
+	// Left turners yield to the opposing traffic, which saturates the shared lanes from around one car in 175
+	// frames per approach, so the default stays well below that.
+	int m_probability[4]{ 250, 250, 250, 250 };
+
+	// One in this many cars turns left, and as many again turn right.
+	int probability_turn = 5;
+
+	SignalTiming east_west_timing;
+	SignalTiming north_south_timing;
+
+	RandomStream m_arrivals[4];
+	RandomStream m_placement[4];
+
+	std::size_t m_pending[4]{ 0, 0, 0, 0 };
+	std::size_t m_departures[4]{ 0, 0, 0, 0 };
+	double m_next_arrival[4]{ 0.0, 0.0, 0.0, 0.0 };
+	double m_time{ 0.0 };
+	ApproachMetrics m_metrics[4];
+
+	bool m_record_delays{ false };
+	std::vector<double> m_delays;
+	std::vector<double> m_delay_times;
+
+	DensityGrid m_density;
+	bool m_track_recent_density{ false };
+	DensityGrid m_recent_density;
+	std::size_t m_detail_limit{ 0 };
 
 	constexpr static POINT top_left = { 0, 0 };
 
 	std::size_t seconds_since_last_switch{ 0 };
 
+	TrafficLightDrawable north_light;
+	TrafficLightDrawable east_light;
+	TrafficLightDrawable south_light;
 	TrafficLightDrawable west_light;
-	Road<Orientation::HORIZONTAL> west_road;
-	Road<Orientation::HORIZONTAL> east_road;
 
-	TrafficLightDrawable north_light;
-	Road<Orientation::VERTICAL> north_road;
-	Road<Orientation::VERTICAL> south_road;
+	Road<Direction::NORTH> north_road;
+	Road<Direction::EAST> east_road;
+	Road<Direction::SOUTH> south_road;
+	Road<Direction::WEST> west_road;
+
+	// Geometry shared by every approach, measured along a car's path from where it spawns.
+	Vector2<float> m_centre{ 0.0f, 0.0f };
+	float m_lane_width{ 0.0f };
+	float m_reach{ 0.0f };
+	float m_stop_distance{ 0.0f };
+
+	constexpr static float clearing_distance = 120.0f;
+	constexpr static float braking_distance = 80.0f;
+	constexpr static float crossing_margin = 0.01f;
+	// Seconds to spare between a left turner clearing the opposing lane and the next opposing car reaching it.
+	constexpr static float critical_gap = 0.5f;
+	constexpr static double shortest_step = 0.5 / FPS;
+	constexpr static LONG density_cell_size = 20;
+	constexpr static double recent_density_half_life = 3.0;
 
-	HBRUSH background_brush;
 	constexpr static COLORREF background_color = 0x0040404040;
 
-	std::vector<std::shared_ptr<Car<Orientation::HORIZONTAL>>> m_horizontal_cars;
-	std::vector<std::shared_ptr<Car<Orientation::VERTICAL>>> m_vertical_cars;
+	Cars<Direction::NORTH> m_north_cars;
+	Cars<Direction::EAST> m_east_cars;
+	Cars<Direction::SOUTH> m_south_cars;
+	Cars<Direction::WEST> m_west_cars;
 
+	// Opposing approaches share each green, so left turns are permitted rather than protected: the turners
+	// yield in the box until the opposing traffic leaves them a gap (see left_turn_clear).
 	enum class State {
-		WEST_DRIVING_NORTH_STOPPED,
-		WEST_STOPPING_NORTH_STOPPED,
-		WEST_STOPPED_NORTH_STARTING,
-		WEST_STOPPED_NORTH_DRIVING,
-		WEST_STOPPED_NORTH_STOPPING,
-		WEST_STARTING_NORTH_STOPPED,
-	} current_state{ State::WEST_DRIVING_NORTH_STOPPED };
+		EAST_WEST_DRIVING_NORTH_SOUTH_STOPPED,
+		EAST_WEST_STOPPING_NORTH_SOUTH_STOPPED,
+		EAST_WEST_STOPPED_NORTH_SOUTH_STARTING,
+		EAST_WEST_STOPPED_NORTH_SOUTH_DRIVING,
+		EAST_WEST_STOPPED_NORTH_SOUTH_STOPPING,
+		EAST_WEST_STARTING_NORTH_SOUTH_STOPPED,
+	} current_state{ State::EAST_WEST_DRIVING_NORTH_SOUTH_STOPPED };
 
 };
 
-void Intersection::iterate_frame()
+template<Direction approach>
+bool Intersection::can_drive() const
 {
-	bool should_make_new_one_top = rand() % probability_north == 0;
-	bool should_make_new_one_left = rand() % probability_west == 0;
+	if constexpr (axis_of(approach) == Orientation::HORIZONTAL)
+		return current_state == State::EAST_WEST_STARTING_NORTH_SOUTH_STOPPED || current_state == State::EAST_WEST_DRIVING_NORTH_SOUTH_STOPPED;
+	else
+		return current_state == State::EAST_WEST_STOPPED_NORTH_SOUTH_STARTING || current_state == State::EAST_WEST_STOPPED_NORTH_SOUTH_DRIVING;
+}
 
-	if (should_make_new_one_top)
-		m_vertical_cars.push_back(std::make_shared<Car<Orientation::VERTICAL>>(Vector2<float>{ (float)( north_road.position().x + rand() % (north_road.size().cx - 20)), (float)north_road.position().y }));
-	if (should_make_new_one_left)
-		m_horizontal_cars.push_back(std::make_shared<Car<Orientation::HORIZONTAL>>( Vector2<float>{ (float)west_road.position().x, (float)(west_road.position().y + rand() % (north_road.size().cx - 20)) }));
+template<Direction approach>
+const Intersection::Cars<approach>& Intersection::cars_of() const
+{
+	if constexpr (approach == Direction::NORTH) return m_north_cars;
+	if constexpr (approach == Direction::EAST) return m_east_cars;
+	if constexpr (approach == Direction::SOUTH) return m_south_cars;
+	if constexpr (approach == Direction::WEST) return m_west_cars;
+}
 
-	std::shared_ptr<Car<Orientation::HORIZONTAL>> previous_horizontal;
+template<Direction approach>
+std::size_t Intersection::queued_of() const
+{
+	const auto& cars = cars_of<approach>();
+	return std::count_if(cars.begin(), cars.end(), [this](const auto& car) { return car->speed() <= 0.0f && car->distance() <= m_stop_distance; });
+}
 
-	const auto clearing_distance = 120;
+std::size_t Intersection::cars(Direction approach) const
+{
+	switch (approach)
+	{
+	case Direction::NORTH: return m_north_cars.size();
+	case Direction::EAST: return m_east_cars.size();
+	case Direction::SOUTH: return m_south_cars.size();
+	case Direction::WEST: return m_west_cars.size();
+	}
+	return 0;
+}
 
-	std::vector<std::vector<std::shared_ptr<Car<Orientation::HORIZONTAL>>>::iterator> h_iterators;
-	for (auto iter = m_horizontal_cars.begin(); iter != m_horizontal_cars.end(); iter++) {
-		auto& car = *iter->get();
-		const bool can_drive = current_state == State::WEST_STARTING_NORTH_STOPPED || current_state == State::WEST_DRIVING_NORTH_STOPPED;
-		bool should_drive;
-		if (previous_horizontal.get() == nullptr)
-			should_drive = can_drive || car.position().x() < west_road.position().x + west_road.size().cy - clearing_distance || car.position().x() > west_road.position().x + west_road.size().cy - 40;
-		else
-			should_drive = (can_drive && car.position().x() < previous_horizontal->position().x() - clearing_distance) || (car.position().x() < previous_horizontal->position().x() - clearing_distance && previous_horizontal->position().x() < west_road.position().x + west_road.size().cy);
-		car.update(should_drive);
-		if (car.position().x() > east_road.position().x + east_road.size().cy)
-			h_iterators.push_back(iter);
-		previous_horizontal = *iter;
+std::size_t Intersection::queued(Direction approach) const
+{
+	switch (approach)
+	{
+	case Direction::NORTH: return queued_of<Direction::NORTH>();
+	case Direction::EAST: return queued_of<Direction::EAST>();
+	case Direction::SOUTH: return queued_of<Direction::SOUTH>();
+	case Direction::WEST: return queued_of<Direction::WEST>();
 	}
-	
-	for(int i = h_iterators.size()-1; i >= 0; i--)
-		m_horizontal_cars.erase(h_iterators[i]);
-
-	std::shared_ptr<Car<Orientation::VERTICAL>> previous_vertical;
-
-	std::vector<std::vector<std::shared_ptr<Car<Orientation::VERTICAL>>>::iterator> iterators;
-	for (auto iter = m_vertical_cars.begin(); iter != m_vertical_cars.end(); iter++) {
-		auto& car = *iter->get();
-		const bool can_drive = current_state == State::WEST_STOPPED_NORTH_DRIVING || current_state == State::WEST_STOPPED_NORTH_STARTING;
-		bool should_drive;
-		if (previous_vertical.get() == nullptr)
-			should_drive = can_drive || car.position().y() < north_road.position().y + north_road.size().cy - clearing_distance || car.position().y() > north_road.position().y + north_road.size().cy - 40;
+	return 0;
+}
+
+void Intersection::adjust_probability(Orientation axis, int change)
+{
+	for (const auto approach : { Direction::NORTH, Direction::EAST, Direction::SOUTH, Direction::WEST })
+		if (axis_of(approach) == axis)
+			set_probability(approach, max(probability(approach) + change, 1));
+}
+
+void Intersection::set_probability(Direction approach, int probability)
+{
+	m_probability[(int)approach] = max(probability, 0);
+	schedule_arrival(approach, m_time);
+}
+
+void Intersection::seed(unsigned int seed, bool antithetic)
+{
+	for (int approach = 0; approach < 4; approach++) {
+		m_arrivals[approach].seed(seed, 2 * approach, antithetic);
+		m_placement[approach].seed(seed, 2 * approach + 1, antithetic);
+		schedule_arrival((Direction)approach, m_time);
+	}
+}
+
+void Intersection::schedule_arrival(Direction approach, double from)
+{
+	// A car arriving on any frame with chance 1/p means a geometric number of frames until the next one, so
+	// the gap is drawn in one go instead of a draw per frame. Always draw, so the arrival stream stays in
+	// step with other scenarios even while an approach is off.
+	const auto probability = m_probability[(int)approach];
+	const auto draw = m_arrivals[(int)approach].uniform();
+	if (probability == 0) {
+		m_next_arrival[(int)approach] = INFINITY;
+		return;
+	}
+
+	const auto gap = probability == 1 ? 0.0 : floor(log(draw) / log(1.0 - 1.0 / probability));
+	m_next_arrival[(int)approach] = from + gap / FPS;
+}
+
+template<Direction approach>
+void Intersection::spawn_car(Cars<approach>& cars)
+{
+	// Steps may not land on a frame exactly, so a car arriving within half a frame spawns now.
+	const auto arrived = m_next_arrival[(int)approach] <= m_time + 0.5 / FPS;
+	if (arrived)
+		schedule_arrival(approach, m_next_arrival[(int)approach] + 1.0 / FPS);
+
+	// Injected cars only enter once the previous car has cleared the entrance.
+	const auto injected = !arrived && m_pending[(int)approach] > 0 && (cars.empty() || cars.back()->distance() >= clearing_distance);
+	if (!arrived && !injected)
+		return;
+	if (injected)
+		m_pending[(int)approach]--;
+
+	auto& random = m_placement[(int)approach];
+
+	// Turning paths meet the exit lane at the same lateral offset they entered with, so every path is
+	// symmetric about its turn point and the exit distance is simply twice the turn distance.
+	const auto offset = Car<approach>::width / 2 + (float)random.below((int)(m_lane_width - Car<approach>::width));
+	const auto turn = random.below(probability_turn);
+	const auto movement = turn == 0 ? Movement::LEFT : turn == 1 ? Movement::RIGHT : Movement::THROUGH;
+
+	auto turn_distance = m_reach;
+	if (movement == Movement::LEFT)
+		turn_distance += offset;
+	else if (movement == Movement::RIGHT)
+		turn_distance -= offset;
+
+	const auto spawn = m_centre + right_of(Car<approach>::heading) * offset - Car<approach>::heading * m_reach;
+	cars.push_back(std::make_shared<Car<approach>>(spawn, movement, turn_distance, 2 * turn_distance, (COLORREF)random.below(0x01000000)));
+	m_metrics[(int)approach].spawned++;
+}
+
+template<Direction approach>
+double Intersection::decide_cars(Cars<approach>& cars)
+{
+	const bool green = can_drive<approach>();
+
+	// Every condition below compares distances, and cars never move backwards, so the time until a car or
+	// the one ahead of it covers the distance to a threshold bounds how long the decision holds. A car
+	// closing in on the one ahead is timed as if that one stood still, which can only be early. Each time is
+	// taken a hair past the threshold, so the condition has flipped by the time it is evaluated again.
+	const auto until = [](const Car<approach>& car, float distance) {
+		return distance < 0.0f ? INFINITY : (double)car.time_to_cover(distance + crossing_margin);
+	};
+
+	// Taking the earliest through a function rather than the min macro times every event only once.
+	double bound = INFINITY;
+	const auto limit = [&bound](double time) { bound = time < bound ? time : bound; };
+	const Car<approach>* previous = nullptr;
+	for (const auto& pointer : cars) {
+		auto& car = *pointer;
+		const auto distance = car.distance();
+		const auto deciding = distance >= m_stop_distance - braking_distance && distance <= m_stop_distance;
+		bool should_drive = green || !deciding;
+		if (previous != nullptr) {
+			should_drive = distance < previous->distance() - clearing_distance && (should_drive || previous->distance() < m_stop_distance + Car<approach>::length);
+			// Nobody follows a left turner into the box while it waits there, or the queue behind it would stand
+			// across the path of the opposing left turn.
+			if (previous->movement() == Movement::LEFT) {
+				const auto waiting = previous->distance() <= yield_distance(*previous);
+				if (deciding && waiting)
+					should_drive = false;
+				limit(until(*previous, yield_distance(*previous) - previous->distance()));
+			}
+		}
+		// Left turns are permitted, not protected: a left turner enters the box on green and waits short of the
+		// opposing lane, as it would at a red light, until opposing traffic leaves a gap. It clears at the latest
+		// once the opposing approach has stopped for red.
+		if (car.movement() == Movement::LEFT) {
+			const auto yield = yield_distance(car);
+			if (distance >= yield - braking_distance && distance <= yield)
+				should_drive = left_turn_clear<approach>(car, bound) && should_drive;
+			limit(until(car, yield - braking_distance - distance));
+			limit(until(car, yield - distance));
+		}
+		car.decide(should_drive);
+
+		limit(until(car, m_stop_distance - braking_distance - distance));
+		limit(until(car, m_stop_distance - distance));
+		limit(until(car, car.exit_distance() - distance));
+		if (previous != nullptr) {
+			const auto gap = previous->distance() - clearing_distance - distance;
+			limit(gap > 0.0f ? until(car, gap) : until(*previous, -gap));
+			limit(until(*previous, m_stop_distance + Car<approach>::length - previous->distance()));
+			limit(until(*previous, previous->exit_distance() - previous->distance()));
+		}
+		previous = &car;
+	}
+
+	if (m_pending[(int)approach] > 0)
+		limit(cars.empty() ? 0.0 : until(*cars.back(), clearing_distance - cars.back()->distance()));
+	limit(m_next_arrival[(int)approach] - m_time);
+	return bound;
+}
+
+template<Direction approach>
+float Intersection::yield_distance(const Car<approach>& car) const
+{
+	// A left turn meets the exit lane at the offset it entered with, so its turn point lies that far beyond
+	// the centre and it crosses the middle of the road offset further on, less half a car for its front.
+	const auto offset = car.turn_distance() - m_reach;
+	return car.turn_distance() + max(offset - Car<approach>::length / 2, 0.0f);
+}
+
+template<Direction approach>
+bool Intersection::left_turn_clear(const Car<approach>& turner, double& bound) const
+{
+	constexpr auto opposing = opposite_of(approach);
+	const auto until = [](const Car<opposing>& car, float distance) {
+		return distance < 0.0f ? INFINITY : (double)car.time_to_cover(distance + crossing_margin);
+	};
+	const auto limit = [&bound](double time) { bound = time < bound ? time : bound; };
+
+	// The turner is across once its tail is past the far side of the opposing lane. Timed from a standstill
+	// where it yields, so the answer does not shift while it slows down.
+	const auto offset = turner.turn_distance() - m_reach;
+	const auto across = turner.turn_distance() + offset + m_lane_width + Car<approach>::length / 2;
+	const auto needed = (double)Car<approach>::time_from_rest(across - yield_distance(turner)) + critical_gap;
+
+	// Distances along an opposing path at which a car's front reaches the turner's path and its tail leaves it.
+	const auto reaching = m_reach - offset - (Car<opposing>::width + Car<opposing>::length) / 2;
+	const auto passed = m_reach - offset + (Car<opposing>::width + Car<opposing>::length) / 2;
+
+	auto clear = true;
+	for (const auto& pointer : cars_of<opposing>()) {
+		const auto& car = *pointer;
+		const auto distance = car.distance();
+
+		// Right turners head into the same exit as the turner, so they have to leave the box first.
+		const auto cleared = car.movement() == Movement::RIGHT ? car.turn_distance() + m_lane_width + Car<opposing>::length / 2 : passed;
+		if (distance > cleared)
+			continue;
+
+		// Opposing left turners waiting to cross can stand across each other's path, so they go first come,
+		// first served, and the later one waits for the other to leave. Only a tie falls back on the approach.
+		if (car.movement() == Movement::LEFT && distance >= yield_distance(car) - braking_distance) {
+			const auto earlier = car.yielding_since() < turner.yielding_since()
+				|| (car.yielding_since() == turner.yielding_since() && (int)opposing < (int)approach);
+			if (earlier) {
+				clear = false;
+				limit(until(car, cleared - distance));
+			}
+			continue;
+		}
+		if (car.movement() == Movement::LEFT)
+			limit(until(car, yield_distance(car) - braking_distance - distance));
+
+		if (distance > reaching) {
+			clear = false;
+			limit(until(car, cleared - distance));
+			continue;
+		}
+
+		const auto arriving = (double)car.time_to_cover(reaching - distance);
+		if (arriving <= needed)
+			clear = false;
 		else
-			should_drive = (can_drive && car.position().y() < previous_vertical->position().y() - clearing_distance) || (car.position().y() < previous_vertical->position().y() - clearing_distance && previous_vertical->position().y() < north_road.position().y + north_road.size().cy);
-		car.update(should_drive);
-		if (car.position().y() > south_road.position().y + south_road.size().cy)
-			iterators.push_back(iter);
-		previous_vertical = *iter;
+			limit(arriving - needed);
 	}
+	return clear;
+}
 
-	for (int i = iterators.size() - 1; i >= 0; i--)
-		m_vertical_cars.erase(iterators[i]);
+template<Direction approach>
+void Intersection::advance_cars(Cars<approach>& cars, float time)
+{
+	for (const auto& car : cars) {
+		const auto from = car->position();
+		car->advance(time);
+		m_density.add(from.x(), from.y(), car->position().x(), car->position().y(), time);
+		if (m_track_recent_density)
+			m_recent_density.add(from.x(), from.y(), car->position().x(), car->position().y(), time);
+		if (car->movement() == Movement::LEFT && car->yielding_since() == INFINITY && car->distance() >= yield_distance(*car) - braking_distance)
+			car->start_yielding(m_time);
+	}
+
+	auto& metrics = m_metrics[(int)approach];
+	cars.erase(std::remove_if(cars.begin(), cars.end(), [this, &metrics](const auto& car) {
+		if (!car->finished())
+			return false;
+		metrics.completed++;
+		m_departures[(int)exit_side_of(approach, car->movement())]++;
+		metrics.travel_time += car->time();
+		metrics.delay += car->delay();
+		if (m_record_delays) {
+			m_delays.push_back(car->delay());
+			m_delay_times.push_back(m_time);
+		}
+		return true;
+	}), cars.end());
+}
+
+double Intersection::prepare()
+{
+	spawn_car<Direction::NORTH>(m_north_cars);
+	spawn_car<Direction::EAST>(m_east_cars);
+	spawn_car<Direction::SOUTH>(m_south_cars);
+	spawn_car<Direction::WEST>(m_west_cars);
+
+	// Decided into locals first, since the min macro would evaluate its arguments twice.
+	const double bounds[] = {
+		decide_cars<Direction::NORTH>(m_north_cars),
+		decide_cars<Direction::EAST>(m_east_cars),
+		decide_cars<Direction::SOUTH>(m_south_cars),
+		decide_cars<Direction::WEST>(m_west_cars),
+	};
+	return *std::min_element(std::begin(bounds), std::end(bounds));
+}
+
+void Intersection::advance_to(double time)
+{
+	// Finished cars are stamped with the end of the step they finished in.
+	const auto step = (float)(time - m_time);
+	m_time = time;
+	m_density.elapse(step);
+	if (m_track_recent_density)
+		m_recent_density.elapse(step);
+	advance_cars<Direction::NORTH>(m_north_cars, step);
+	advance_cars<Direction::EAST>(m_east_cars, step);
+	advance_cars<Direction::SOUTH>(m_south_cars, step);
+	advance_cars<Direction::WEST>(m_west_cars, step);
+}
+
+void Intersection::iterate_frame()
+{
+	prepare();
+	advance_to(m_time + 1.0 / FPS);
+}
+
+void Intersection::simulate(std::size_t seconds)
+{
+	for (std::size_t second = 0; second < seconds; second++) {
+		const auto tick = m_time + 1.0;
+		while (m_time < tick) {
+			// prepare() spawns and decides, so it must run exactly once per step, outside the min and max macros.
+			const auto bound = prepare();
+			const auto next = m_time + max(bound, shortest_step);
+			advance_to(min(next, tick));
+		}
+		iterate_trafficlight();
+	}
+}
+
+void Intersection::set_lights(TrafficLight::State east_west, TrafficLight::State north_south)
+{
+	east_light.set_state(east_west);
+	west_light.set_state(east_west);
+	north_light.set_state(north_south);
+	south_light.set_state(north_south);
+	seconds_since_last_switch = 0;
 }
 
 void Intersection::iterate_trafficlight()
@@ -300,80 +893,101 @@ void Intersection::iterate_trafficlight()
 
 	switch (current_state)
 	{
-	case State::WEST_DRIVING_NORTH_STOPPED:
-		if (seconds_since_last_switch >= 9) {
-			current_state = State::WEST_STOPPING_NORTH_STOPPED;
-			west_light.set_state(TrafficLight::State::YELLOW);
-			north_light.set_state(TrafficLight::State::RED);
-			seconds_since_last_switch = 0;
+	case State::EAST_WEST_DRIVING_NORTH_SOUTH_STOPPED:
+		if (seconds_since_last_switch >= east_west_timing.driving) {
+			current_state = State::EAST_WEST_STOPPING_NORTH_SOUTH_STOPPED;
+			set_lights(TrafficLight::State::YELLOW, TrafficLight::State::RED);
 		}
 		break;
-	case State::WEST_STOPPING_NORTH_STOPPED:
-		if (seconds_since_last_switch >= 2)
+	case State::EAST_WEST_STOPPING_NORTH_SOUTH_STOPPED:
+		if (seconds_since_last_switch >= east_west_timing.stopping)
 		{
-			current_state = State::WEST_STOPPED_NORTH_STARTING;
-			west_light.set_state(TrafficLight::State::RED);
-			north_light.set_state(TrafficLight::State::ALMOST_GREEN);
-			seconds_since_last_switch = 0;
+			current_state = State::EAST_WEST_STOPPED_NORTH_SOUTH_STARTING;
+			set_lights(TrafficLight::State::RED, TrafficLight::State::ALMOST_GREEN);
 		}
 		break;
-	case State::WEST_STOPPED_NORTH_STARTING:
-		if (seconds_since_last_switch >= 2)
+	case State::EAST_WEST_STOPPED_NORTH_SOUTH_STARTING:
+		if (seconds_since_last_switch >= north_south_timing.starting)
 		{
-			current_state = State::WEST_STOPPED_NORTH_DRIVING;
-			west_light.set_state(TrafficLight::State::RED);
-			north_light.set_state(TrafficLight::State::GREEN);
-			seconds_since_last_switch = 0;
+			current_state = State::EAST_WEST_STOPPED_NORTH_SOUTH_DRIVING;
+			set_lights(TrafficLight::State::RED, TrafficLight::State::GREEN);
 		}
-	case State::WEST_STOPPED_NORTH_DRIVING:
-		if (seconds_since_last_switch >= 9)
+		break;
+	case State::EAST_WEST_STOPPED_NORTH_SOUTH_DRIVING:
+		if (seconds_since_last_switch >= north_south_timing.driving)
 		{
-			current_state = State::WEST_STOPPED_NORTH_STOPPING;
-			west_light.set_state(TrafficLight::State::RED);
-			north_light.set_state(TrafficLight::State::YELLOW);
-			seconds_since_last_switch = 0;
+			current_state = State::EAST_WEST_STOPPED_NORTH_SOUTH_STOPPING;
+			set_lights(TrafficLight::State::RED, TrafficLight::State::YELLOW);
 		}
 		break;
-	case State::WEST_STOPPED_NORTH_STOPPING:
-		if (seconds_since_last_switch >= 2)
+	case State::EAST_WEST_STOPPED_NORTH_SOUTH_STOPPING:
+		if (seconds_since_last_switch >= north_south_timing.stopping)
 		{
-			current_state = State::WEST_STARTING_NORTH_STOPPED;
-			west_light.set_state(TrafficLight::State::ALMOST_GREEN);
-			north_light.set_state(TrafficLight::State::RED);
-			seconds_since_last_switch = 0;
+			current_state = State::EAST_WEST_STARTING_NORTH_SOUTH_STOPPED;
+			set_lights(TrafficLight::State::ALMOST_GREEN, TrafficLight::State::RED);
 		}
 		break;
-	case State::WEST_STARTING_NORTH_STOPPED:
-		if (seconds_since_last_switch >= 2)
+	case State::EAST_WEST_STARTING_NORTH_SOUTH_STOPPED:
+		if (seconds_since_last_switch >= east_west_timing.starting)
 		{
-			current_state = State::WEST_DRIVING_NORTH_STOPPED;
-			west_light.set_state(TrafficLight::State::GREEN);
-			north_light.set_state(TrafficLight::State::RED);
-			seconds_since_last_switch = 0;
+			current_state = State::EAST_WEST_DRIVING_NORTH_SOUTH_STOPPED;
+			set_lights(TrafficLight::State::GREEN, TrafficLight::State::RED);
 		}
 		break;
 	}
 }
 
-Intersection::Intersection()
+Intersection::Intersection(unsigned int seed, bool antithetic)
 {
-	const auto total_height = north_road.size().cy*2+north_road.size().cx;
+	this->seed(seed, antithetic);
 
-	west_light.set_size(100);
-	west_light.set_position({ 180, 180 });
-	west_light.set_state(TrafficLight::State::GREEN);
+	const auto total_height = north_road.size().cy*2+north_road.size().cx;
 
 	north_light.set_size(100);
 	north_light.set_position({ 700, 650 });
-	north_light.set_state(TrafficLight::State::RED);
+	east_light.set_size(100);
+	east_light.set_position({ 700, 180 });
+	south_light.set_size(100);
+	south_light.set_position({ 180, 650 });
+	west_light.set_size(100);
+	west_light.set_position({ 180, 180 });
+	set_lights(TrafficLight::State::GREEN, TrafficLight::State::RED);
 
 	west_road.set_position({ top_left.x, top_left.y + (total_height / 2) - (west_road.size().cx/2)});
 	east_road.set_position({ west_road.position().x+west_road.size().cy+north_road.size().cx, west_road.position().y });
 	north_road.set_position({ top_left.x + (total_height / 2) - (west_road.size().cx / 2), top_left.y });
 	south_road.set_position({ north_road.position().x, north_road.position().y+north_road.size().cy+north_road.size().cx });
 
-	background_brush = CreateSolidBrush(background_color);
+	m_centre = { (float)(top_left.x + total_height / 2), (float)(top_left.y + total_height / 2) };
+	m_lane_width = north_road.size().cx / 2.0f;
+	m_reach = north_road.size().cy + m_lane_width;
+	m_stop_distance = north_road.size().cy - Car<Direction::NORTH>::length / 2;
+
+	m_density = DensityGrid({ top_left.x, top_left.y, top_left.x + total_height, top_left.y + total_height }, density_cell_size);
+	m_detail_limit = road_capacity();
+}
+
+void Intersection::track_recent_density(bool track)
+{
+	m_track_recent_density = track;
+	m_recent_density = track ? DensityGrid(m_density.bounds(), density_cell_size, recent_density_half_life) : DensityGrid();
+}
 
+std::size_t Intersection::road_capacity() const
+{
+	// Every road has a lane in and a lane out, and a queue puts a car at each end of a lane.
+	const auto per_lane = (std::size_t)(north_road.size().cy / clearing_distance) + 1;
+	return 4 * 2 * per_lane;
+}
+
+void Intersection::cycle_detail_limit()
+{
+	if (m_detail_limit == 0)
+		m_detail_limit = SIZE_MAX;
+	else if (m_detail_limit == SIZE_MAX)
+		m_detail_limit = road_capacity();
+	else
+		m_detail_limit = 0;
 }
 
 void Intersection::draw(const HDC context) const
@@ -383,31 +997,58 @@ void Intersection::draw(const HDC context) const
 	north_road.draw(context);
 	south_road.draw(context);
 	north_light.draw(context);
+	east_light.draw(context);
+	south_light.draw(context);
 	west_light.draw(context);
 
 	RECT text = { 0, 50, 400, 100 };
 	RECT text2 = { 0, 100, 400, 150};
+	RECT text3 = { 0, 150, 400, 200 };
 
-	const auto* a = "The probability of north/frame: 1/%d (%.02f %%)";
-	const auto* b = "The probability of west/frame: 1/%d (%.02f %%)";
+	const auto* a = "The probability of north/south/frame: 1/%d (%.02f %%)";
+	const auto* b = "The probability of east/west/frame: 1/%d (%.02f %%)";
 	CHAR buf[100]{ 0 };
 	CHAR buf2[100]{ 0 };
 
-	sprintf_s(buf, a, probability_north, 100.0f/probability_north);
-	sprintf_s(buf2, b, probability_west, 100.0f/probability_west);
+	sprintf_s(buf, a, probability(Direction::NORTH), 100.0f/probability(Direction::NORTH));
+	sprintf_s(buf2, b, probability(Direction::WEST), 100.0f/probability(Direction::WEST));
 
 	DrawTextA(context, buf, strlen(buf), &text, 0);
 	DrawTextA(context, buf2, strlen(buf2), &text2, 0);
 
+	CHAR buf3[100]{ 0 };
+	if (m_detail_limit == 0)
+		sprintf_s(buf3, "Drawing the density grid (D to change)");
+	else if (m_detail_limit == SIZE_MAX)
+		sprintf_s(buf3, "Drawing every car (D to change)");
+	else
+		sprintf_s(buf3, "Drawing the density grid beyond %zu cars (D to change)", m_detail_limit);
+	DrawTextA(context, buf3, strlen(buf3), &text3, 0);
+
 	const RECT intersection_rect{ west_road.position().x + west_road.size().cy, north_road.position().y + north_road.size().cy, east_road.position().x, south_road.position().y };
 	
-	FillRect(context, &intersection_rect, background_brush);
+	SetDCBrushColor(context, background_color);
+	FillRect(context, &intersection_rect, (HBRUSH)GetStockObject(DC_BRUSH));
+
+	const auto total_cars = m_north_cars.size() + m_east_cars.size() + m_south_cars.size() + m_west_cars.size();
+	if (total_cars > m_detail_limit) {
+		(m_track_recent_density ? m_recent_density : m_density).draw(context, Car<Direction::NORTH>::max_speed);
+		return;
+	}
+
+	for (const auto& car : m_north_cars) {
+		car->draw(context);
+	}
+
+	for (const auto& car : m_east_cars) {
+		car->draw(context);
+	}
 
-	for (const auto& car : m_horizontal_cars) {
+	for (const auto& car : m_south_cars) {
 		car->draw(context);
 	}
 
-	for (const auto& car : m_vertical_cars) {
+	for (const auto& car : m_west_cars) {
 		car->draw(context);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,319 @@
+#pragma once
+
+#include "Intersection.h"
+#include "CellTransmission.h"
+
+#include <cstdint>
+
+// Counters of one intersection, as needed to report on the network.
+struct IntersectionReport
+{
+	std::uint64_t spawned{ 0 };
+	std::uint64_t cars{ 0 };
+	std::uint64_t completed{ 0 };
+	double delay{ 0.0 };
+};
+
+struct NetworkReport
+{
+	std::uint64_t spawned{ 0 };
+	std::uint64_t exited{ 0 };
+	std::uint64_t in_intersections{ 0 };
+	std::uint64_t completed{ 0 };
+	double on_links{ 0.0 };
+	double delay{ 0.0 };
+};
+
+// Adds up per intersection and per link figures in index order, so the totals come out the same to the
+// last bit however the network was split up to produce them.
+NetworkReport combine_reports(const IntersectionReport* intersections, std::size_t count, const double* link_totals, std::size_t links, std::uint64_t exited)
+{
+	NetworkReport report;
+	report.exited = exited;
+	for (std::size_t index = 0; index < count; index++) {
+		report.spawned += intersections[index].spawned;
+		report.in_intersections += intersections[index].cars;
+		report.completed += intersections[index].completed;
+		report.delay += intersections[index].delay;
+	}
+	for (std::size_t link = 0; link < links; link++)
+		report.on_links += link_totals[link];
+	return report;
+}
+
+// A grid of microscopic intersections joined by cell transmission roads. Cars are simulated one by one only
+// inside the intersections; on the roads between them they are flow, converted back into cars when they
+// reach the next intersection. Approaches on the edge of the grid keep their own random arrivals, and cars
+// leaving by an edge leave the network.
+//
+// The grid can be split into partitions of whole rows, each owning its intersections and the links into
+// them. A step first advances every intersection, which posts the cars leaving it into one mailbox slot per
+// link, and then advances every link from its slot. Nothing else crosses a partition, every intersection is
+// seeded by its index and every link is stepped by the same code, so a partitioned run is bitwise identical
+// to a single one.
+class Network
+{
+public:
+	struct LinkInfo
+	{
+		// Cars leave the upstream intersection by side and enter the downstream one from approach.
+		std::size_t from;
+		Direction side;
+		std::size_t to;
+		Direction approach;
+	};
+
+	struct Link
+	{
+		std::size_t id;
+		LinkInfo info;
+
+		CellTransmissionRoad road;
+		// Fraction of a car that has left the road but is not yet whole enough to inject.
+		float delivered{ 0.0f };
+	};
+
+	Network(std::size_t rows, std::size_t columns, std::size_t link_cells, unsigned int seed, std::size_t partition = 0, std::size_t partitions = 1);
+
+	// Advances every intersection and road by one second.
+	void step();
+	void simulate(std::size_t seconds);
+
+	// The two halves of step(), for when the partitions live in separate processes. departures holds one
+	// slot per link: step_intersections() fills the slots of links leaving this partition's intersections
+	// and step_links() reads the slots of links entering them.
+	void step_intersections(std::uint32_t* departures);
+	void step_links(const std::uint32_t* departures);
+
+	void set_boundary_probability(int probability);
+	void set_timing(Orientation axis, SignalTiming timing);
+
+	std::size_t rows() const { return m_rows; }
+	std::size_t columns() const { return m_columns; }
+	std::size_t seconds() const { return m_seconds; }
+
+	std::size_t intersections() const { return m_intersections.size(); }
+	bool owns(std::size_t index) const { return m_intersections[index] != nullptr; }
+	Intersection& intersection(std::size_t index) { return *m_intersections[index]; }
+	const Intersection& intersection(std::size_t index) const { return *m_intersections[index]; }
+
+	// Links into this partition, in id order.
+	const std::vector<Link>& links() const { return m_links; }
+	std::size_t link_count() const { return m_link_count; }
+
+	// Cars that left by an edge of the grid from this partition.
+	std::uint64_t exited() const { return m_exited; }
+
+	IntersectionReport report(std::size_t index) const;
+	// Vehicles on a link's road, including those waiting to get on or off it.
+	static double total_of(const Link& link) { return link.road.total() + link.delivered; }
+	// Only meaningful for an unpartitioned network.
+	NetworkReport report() const;
+
+	// Seed of the intersection at index, the same however the network is split up.
+	static unsigned int seed_of(unsigned int seed, std::size_t index);
+	static std::size_t partition_of(std::size_t index, std::size_t rows, std::size_t columns, std::size_t partitions);
+	// Every link of a grid, in id order.
+	static std::vector<LinkInfo> links_of(std::size_t rows, std::size_t columns);
+
+	// Whether leaving by side takes a car out of the grid.
+	bool is_boundary(std::size_t index, Direction side) const;
+	std::size_t neighbour_of(std::size_t index, Direction side) const;
+
+private:
+	static void step_link(Link& link, std::size_t departures, Intersection& downstream);
+
+	// Cars an approach may have waiting to enter before the road feeding it is held back.
+	constexpr static std::size_t max_pending = 2;
+
+	constexpr static Direction sides[] = { Direction::NORTH, Direction::EAST, Direction::SOUTH, Direction::WEST };
+
+	std::size_t m_rows;
+	std::size_t m_columns;
+	std::size_t m_seconds{ 0 };
+	std::uint64_t m_exited{ 0 };
+	std::size_t m_link_count{ 0 };
+
+	std::vector<std::unique_ptr<Intersection>> m_intersections;
+	std::vector<Link> m_links;
+
+	// Links whose upstream intersection is in this partition, by id.
+	std::vector<std::pair<std::size_t, LinkInfo>> m_outlets;
+	// Mailbox used by step() when every partition is in this process.
+	std::vector<std::uint32_t> m_departures;
+};
+
+unsigned int Network::seed_of(unsigned int seed, std::size_t index)
+{
+	std::seed_seq sequence{ seed, (unsigned int)index };
+	std::uint32_t result;
+	sequence.generate(&result, &result + 1);
+	return result;
+}
+
+std::size_t Network::partition_of(std::size_t index, std::size_t rows, std::size_t columns, std::size_t partitions)
+{
+	return (index / columns) * partitions / rows;
+}
+
+std::vector<Network::LinkInfo> Network::links_of(std::size_t rows, std::size_t columns)
+{
+	std::vector<LinkInfo> links;
+	for (std::size_t index = 0; index < rows * columns; index++) {
+		const auto row = index / columns;
+		const auto column = index % columns;
+		if (row > 0) links.push_back({ index, Direction::NORTH, index - columns, Direction::SOUTH });
+		if (column < columns - 1) links.push_back({ index, Direction::EAST, index + 1, Direction::WEST });
+		if (row < rows - 1) links.push_back({ index, Direction::SOUTH, index + columns, Direction::NORTH });
+		if (column > 0) links.push_back({ index, Direction::WEST, index - 1, Direction::EAST });
+	}
+	return links;
+}
+
+bool Network::is_boundary(std::size_t index, Direction side) const
+{
+	const auto row = index / m_columns;
+	const auto column = index % m_columns;
+	switch (side)
+	{
+	case Direction::NORTH: return row == 0;
+	case Direction::EAST: return column == m_columns - 1;
+	case Direction::SOUTH: return row == m_rows - 1;
+	case Direction::WEST: return column == 0;
+	}
+	return true;
+}
+
+std::size_t Network::neighbour_of(std::size_t index, Direction side) const
+{
+	switch (side)
+	{
+	case Direction::NORTH: return index - m_columns;
+	case Direction::EAST: return index + 1;
+	case Direction::SOUTH: return index + m_columns;
+	case Direction::WEST: return index - 1;
+	}
+	return index;
+}
+
+Network::Network(std::size_t rows, std::size_t columns, std::size_t link_cells, unsigned int seed, std::size_t partition, std::size_t partitions)
+	: m_rows(max(rows, (std::size_t)1))
+	, m_columns(max(columns, (std::size_t)1))
+{
+	const auto count = m_rows * m_columns;
+	partitions = max(partitions, (std::size_t)1);
+
+	m_intersections.resize(count);
+	for (std::size_t index = 0; index < count; index++)
+		if (partition_of(index, m_rows, m_columns, partitions) == partition)
+			m_intersections[index] = std::make_unique<Intersection>(seed_of(seed, index));
+
+	const auto links = links_of(m_rows, m_columns);
+	m_link_count = links.size();
+	m_departures.resize(m_link_count, 0);
+	for (std::size_t id = 0; id < links.size(); id++) {
+		const auto& info = links[id];
+		if (owns(info.from))
+			m_outlets.push_back({ id, info });
+		if (owns(info.to)) {
+			m_intersections[info.to]->set_probability(info.approach, 0);
+			m_links.push_back({ id, info, CellTransmissionRoad(max(link_cells, (std::size_t)1)) });
+		}
+	}
+}
+
+void Network::step_link(Link& link, std::size_t departures, Intersection& downstream)
+{
+	link.road.enter((float)departures);
+
+	const auto waiting = downstream.pending(link.info.approach) + link.delivered;
+	const auto receiving = waiting < max_pending ? max_pending - waiting : 0.0f;
+	link.delivered += link.road.step(receiving);
+
+	const auto whole = (std::size_t)link.delivered;
+	link.delivered -= whole;
+	downstream.inject(link.info.approach, whole);
+}
+
+void Network::step_intersections(std::uint32_t* departures)
+{
+	for (std::size_t index = 0; index < m_intersections.size(); index++) {
+		if (!owns(index))
+			continue;
+		m_intersections[index]->simulate(1);
+		for (const auto side : sides)
+			if (is_boundary(index, side))
+				m_exited += m_intersections[index]->take_departures(side);
+	}
+
+	for (const auto& [id, info] : m_outlets)
+		departures[id] = (std::uint32_t)m_intersections[info.from]->take_departures(info.side);
+}
+
+void Network::step_links(const std::uint32_t* departures)
+{
+	for (auto& link : m_links)
+		step_link(link, departures[link.id], *m_intersections[link.info.to]);
+
+	m_seconds++;
+}
+
+void Network::step()
+{
+	step_intersections(m_departures.data());
+	step_links(m_departures.data());
+}
+
+void Network::simulate(std::size_t seconds)
+{
+	for (std::size_t second = 0; second < seconds; second++)
+		step();
+}
+
+void Network::set_boundary_probability(int probability)
+{
+	for (std::size_t index = 0; index < m_intersections.size(); index++) {
+		if (!owns(index))
+			continue;
+		for (const auto side : sides)
+			if (is_boundary(index, side))
+				m_intersections[index]->set_probability(side, probability);
+	}
+}
+
+void Network::set_timing(Orientation axis, SignalTiming timing)
+{
+	for (auto& intersection : m_intersections)
+		if (intersection != nullptr)
+			intersection->set_timing(axis, timing);
+}
+
+IntersectionReport Network::report(std::size_t index) const
+{
+	IntersectionReport report;
+	const auto& intersection = *m_intersections[index];
+	for (const auto approach : sides) {
+		const auto& metrics = intersection.metrics(approach);
+		if (is_boundary(index, approach))
+			report.spawned += metrics.spawned;
+		// Cars handed over by a link but not yet on the road are off the link, so they count here.
+		report.cars += intersection.cars(approach) + intersection.pending(approach);
+		report.completed += metrics.completed;
+		report.delay += metrics.delay;
+	}
+	return report;
+}
+
+NetworkReport Network::report() const
+{
+	std::vector<IntersectionReport> intersections(m_intersections.size());
+	for (std::size_t index = 0; index < m_intersections.size(); index++)
+		if (owns(index))
+			intersections[index] = report(index);
+
+	std::vector<double> link_totals(m_link_count, 0.0);
+	for (const auto& link : m_links)
+		link_totals[link.id] = total_of(link);
+
+	return combine_reports(intersections.data(), intersections.size(), link_totals.data(), link_totals.size(), m_exited);
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "SharedNetwork.h"
+
+#include <stdexcept>
+
+// A Network split into row partitions, each simulated by its own TrafficWorker process pinned to a NUMA
+// node. Workers exchange the cars crossing partition boundaries once per step through mailboxes in a
+// shared memory section, and the result is bitwise identical to an unpartitioned Network with the same
+// seed. Workers are tied to a job object, so they go away with the host even if it crashes.
+class PartitionedNetwork
+{
+public:
+	PartitionedNetwork(std::size_t rows, std::size_t columns, std::size_t link_cells, unsigned int seed, std::size_t partitions, const std::wstring& worker);
+	~PartitionedNetwork() { shutdown(); }
+
+	PartitionedNetwork(const PartitionedNetwork&) = delete;
+	PartitionedNetwork& operator=(const PartitionedNetwork&) = delete;
+
+	void simulate(std::size_t seconds);
+
+	void set_boundary_probability(int probability);
+	void set_timing(Orientation axis, SignalTiming timing);
+
+	std::size_t seconds() const { return m_seconds; }
+	std::size_t intersections() const { return m_intersections; }
+	std::size_t partitions() const { return m_workers.size(); }
+
+	NetworkReport report();
+
+private:
+	struct Worker
+	{
+		HANDLE process{ nullptr };
+		HANDLE go{ nullptr };
+		HANDLE done{ nullptr };
+	};
+
+	// Hands the command in the header to every worker and waits until all of them have carried it out.
+	void run(WorkerCommand command);
+	void wait(const Worker& worker) const;
+	void shutdown();
+
+	std::size_t m_intersections{ 0 };
+	std::size_t m_links{ 0 };
+	std::size_t m_seconds{ 0 };
+
+	std::wstring m_name;
+	HANDLE m_job{ nullptr };
+	HANDLE m_mapping{ nullptr };
+	void* m_view{ nullptr };
+	SharedNetwork m_shared;
+	std::vector<Worker> m_workers;
+};
+
+PartitionedNetwork::PartitionedNetwork(std::size_t rows, std::size_t columns, std::size_t link_cells, unsigned int seed, std::size_t partitions, const std::wstring& worker)
+{
+	rows = max(rows, (std::size_t)1);
+	columns = max(columns, (std::size_t)1);
+	// Partitions are whole rows, so there is no point having more of them than rows.
+	partitions = min(max(partitions, (std::size_t)1), rows);
+
+	m_intersections = rows * columns;
+	m_links = Network::links_of(rows, columns).size();
+
+	try {
+		m_name = L"Local\\TrafficNetwork-" + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring((std::uintptr_t)this);
+
+		m_job = CreateJobObjectW(nullptr, nullptr);
+		JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+		limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+		if (m_job == nullptr || !SetInformationJobObject(m_job, JobObjectExtendedLimitInformation, &limits, sizeof(limits)))
+			throw std::runtime_error("could not create the job object for traffic workers");
+
+		const auto size = SharedNetwork::size_of(m_intersections, m_links, partitions);
+		m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((std::uint64_t)size >> 32), (DWORD)size, m_name.c_str());
+		if (m_mapping == nullptr)
+			throw std::runtime_error("could not create the shared memory section");
+		m_view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (m_view == nullptr)
+			throw std::runtime_error("could not map the shared memory section");
+
+		m_shared = SharedNetwork::at(m_view, m_intersections, m_links);
+		*m_shared.header = {};
+		m_shared.header->rows = (std::uint32_t)rows;
+		m_shared.header->columns = (std::uint32_t)columns;
+		m_shared.header->link_cells = (std::uint32_t)link_cells;
+		m_shared.header->seed = seed;
+		m_shared.header->partitions = (std::uint32_t)partitions;
+		m_shared.header->links = (std::uint32_t)m_links;
+
+		ULONG highest_node = 0;
+		GetNumaHighestNodeNumber(&highest_node);
+
+		for (std::size_t partition = 0; partition < partitions; partition++) {
+			Worker& current = m_workers.emplace_back();
+			current.go = CreateEventW(nullptr, FALSE, FALSE, SharedNetwork::event_name(m_name, L"go", partition).c_str());
+			current.done = CreateEventW(nullptr, FALSE, FALSE, SharedNetwork::event_name(m_name, L"done", partition).c_str());
+			if (current.go == nullptr || current.done == nullptr)
+				throw std::runtime_error("could not create the worker events");
+
+			const auto node = partition % (highest_node + 1);
+			auto command_line = L"\"" + worker + L"\" " + m_name + L" " + std::to_wstring(partition) + L" " + std::to_wstring(node);
+
+			// Started suspended so it is in the job before it can do anything.
+			STARTUPINFOW startup{ sizeof(startup) };
+			PROCESS_INFORMATION information{};
+			if (!CreateProcessW(worker.c_str(), command_line.data(), nullptr, nullptr, FALSE, CREATE_SUSPENDED | CREATE_NO_WINDOW, nullptr, nullptr, &startup, &information))
+				throw std::runtime_error("could not start a traffic worker");
+			current.process = information.hProcess;
+			const auto assigned = AssignProcessToJobObject(m_job, information.hProcess);
+			ResumeThread(information.hThread);
+			CloseHandle(information.hThread);
+			if (!assigned)
+				throw std::runtime_error("could not add a traffic worker to the job object");
+		}
+
+		// Every worker signals once it has built its part of the network.
+		for (const auto& current : m_workers)
+			wait(current);
+	}
+	catch (...) {
+		shutdown();
+		throw;
+	}
+}
+
+void PartitionedNetwork::wait(const Worker& worker) const
+{
+	const HANDLE handles[] = { worker.done, worker.process };
+	if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+		throw std::runtime_error("a traffic worker exited unexpectedly");
+}
+
+void PartitionedNetwork::run(WorkerCommand command)
+{
+	m_shared.header->command = command;
+	for (const auto& worker : m_workers)
+		SetEvent(worker.go);
+	for (const auto& worker : m_workers)
+		wait(worker);
+}
+
+void PartitionedNetwork::simulate(std::size_t seconds)
+{
+	for (std::size_t second = 0; second < seconds; second++) {
+		run(WorkerCommand::STEP_INTERSECTIONS);
+		run(WorkerCommand::STEP_LINKS);
+		m_seconds++;
+	}
+}
+
+void PartitionedNetwork::set_boundary_probability(int probability)
+{
+	m_shared.header->probability = probability;
+	run(WorkerCommand::SET_DEMAND);
+}
+
+void PartitionedNetwork::set_timing(Orientation axis, SignalTiming timing)
+{
+	m_shared.header->axis = (std::uint32_t)axis;
+	m_shared.header->driving = (std::uint32_t)timing.driving;
+	m_shared.header->stopping = (std::uint32_t)timing.stopping;
+	m_shared.header->starting = (std::uint32_t)timing.starting;
+	run(WorkerCommand::SET_TIMING);
+}
+
+NetworkReport PartitionedNetwork::report()
+{
+	run(WorkerCommand::REPORT);
+
+	std::uint64_t exited = 0;
+	for (std::size_t partition = 0; partition < m_workers.size(); partition++)
+		exited += m_shared.exited[partition];
+	return combine_reports(m_shared.reports, m_intersections, m_shared.link_totals, m_links, exited);
+}
+
+void PartitionedNetwork::shutdown()
+{
+	if (m_shared.header != nullptr) {
+		m_shared.header->command = WorkerCommand::EXIT;
+		for (const auto& worker : m_workers)
+			if (worker.process != nullptr)
+				SetEvent(worker.go);
+		for (const auto& worker : m_workers)
+			if (worker.process != nullptr && WaitForSingleObject(worker.process, 5000) != WAIT_OBJECT_0)
+				TerminateProcess(worker.process, 1);
+	}
+
+	for (auto& worker : m_workers) {
+		for (const auto handle : { worker.process, worker.go, worker.done })
+			if (handle != nullptr)
+				CloseHandle(handle);
+		worker = {};
+	}
+	m_workers.clear();
+
+	if (m_view != nullptr)
+		UnmapViewOfFile(m_view);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_job != nullptr)
+		CloseHandle(m_job);
+	m_view = nullptr;
+	m_mapping = nullptr;
+	m_job = nullptr;
+	m_shared = {};
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <random>
+#include <cstdint>
+
+// A uniform random stream that can be replayed exactly, or mirrored as its antithetic counterpart. The
+// engine keeps one stream per purpose so that two scenarios seeded alike consume identical numbers for
+// identical purposes, whatever else differs between them.
+class RandomStream
+{
+public:
+	RandomStream() = default;
+
+	void seed(std::uint32_t seed, std::uint32_t stream, bool antithetic)
+	{
+		std::seed_seq sequence{ seed, stream };
+		m_engine.seed(sequence);
+		m_antithetic = antithetic;
+	}
+
+	// Uniform on the open interval (0, 1).
+	double uniform()
+	{
+		const auto u = (m_engine() + 0.5) / 4294967296.0;
+		return m_antithetic ? 1.0 - u : u;
+	}
+
+	// Uniform integer in [0, bound). Derived from uniform() so that antithetic streams stay mirrored.
+	int below(int bound)
+	{
+		const auto value = (int)(uniform() * bound);
+		return value < bound ? value : bound - 1;
+	}
+
+	bool antithetic() const { return m_antithetic; }
+
+private:
+	std::mt19937 m_engine;
+	bool m_antithetic{ false };
+};
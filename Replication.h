@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Intersection.h"
+#include "Statistics.h"
+
+struct ReplicationOptions
+{
+	// Hard limit on the length of the run, reached only if the interval never gets narrow enough.
+	std::size_t max_seconds{ 4 * 3600 };
+	// How often the warm-up and the confidence interval are re-evaluated.
+	std::size_t check_seconds{ 60 };
+	// Stop once the 95% interval on mean delay is at most this wide on either side, in seconds.
+	double target_half_width{ 1.0 };
+	std::size_t batches{ 20 };
+	std::size_t min_batch_size{ 10 };
+};
+
+struct ReplicationResult
+{
+	std::size_t seconds{ 0 };
+	// Completed cars discarded as warm-up, and the simulated time by which the last of them was done.
+	std::size_t warmup_cars{ 0 };
+	double warmup_seconds{ 0.0 };
+	// Completed cars the estimate is based on.
+	std::size_t cars{ 0 };
+	// Mean delay per car after the warm-up.
+	ConfidenceInterval delay;
+	bool converged{ false };
+};
+
+// Runs one replication on the intersection as it is, normally freshly constructed so it starts empty. The
+// warm-up is found by MSER-5 on the delay of completed cars and left out of the estimate, and the run stops as
+// soon as the batch means interval on the remaining delays is narrower than the target. Only the result is
+// free of the warm-up: the intersection's ApproachMetrics keep counting every car since construction.
+ReplicationResult run_replication(Intersection& intersection, const ReplicationOptions& options)
+{
+	const auto start_time = intersection.time();
+	const auto check_seconds = max(options.check_seconds, (std::size_t)1);
+	const auto batches = max(options.batches, (std::size_t)2);
+	// Every batch needs a car in it, or an empty series would pass for a converged one.
+	const auto min_batch_size = max(options.min_batch_size, (std::size_t)1);
+
+	intersection.record_delays(true);
+	intersection.clear_delays();
+
+	ReplicationResult result;
+	const auto& delays = intersection.delays();
+	while (result.seconds < options.max_seconds) {
+		const auto step = min(check_seconds, options.max_seconds - result.seconds);
+		intersection.simulate(step);
+		result.seconds += step;
+
+		result.warmup_cars = mser5_truncation(delays);
+		if (delays.size() - result.warmup_cars < batches * min_batch_size)
+			continue;
+
+		result.delay = batch_means_interval(delays, result.warmup_cars, batches);
+		if (result.delay.half_width <= options.target_half_width) {
+			result.converged = true;
+			break;
+		}
+	}
+
+	if (!result.converged)
+		result.delay = batch_means_interval(delays, result.warmup_cars, batches);
+	result.cars = delays.size() - result.warmup_cars;
+	if (result.warmup_cars > 0)
+		result.warmup_seconds = intersection.delay_times()[result.warmup_cars - 1] - start_time;
+
+	intersection.record_delays(false);
+	return result;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Network.h"
+
+#include <windows.h>
+
+#include <cstdint>
+#include <string>
+
+// What the host asks of every worker each time it signals them.
+enum class WorkerCommand : std::uint32_t {
+	STEP_INTERSECTIONS = 0,
+	STEP_LINKS = 1,
+	SET_DEMAND = 2,
+	SET_TIMING = 3,
+	REPORT = 4,
+	EXIT = 5
+};
+
+// Start of the shared memory section. Written by the host before it signals the workers, and only read by
+// them, except for the arrays that follow it.
+struct SharedNetworkHeader
+{
+	std::uint32_t rows;
+	std::uint32_t columns;
+	std::uint32_t link_cells;
+	std::uint32_t seed;
+	std::uint32_t partitions;
+	std::uint32_t links;
+
+	WorkerCommand command;
+
+	// Arguments of SET_DEMAND and SET_TIMING.
+	std::int32_t probability;
+	std::uint32_t axis;
+	std::uint32_t driving;
+	std::uint32_t stopping;
+	std::uint32_t starting;
+};
+
+// The shared memory section of a partitioned network: the header, then the per link departure mailboxes
+// and the report slots every worker fills in for the intersections and links it owns.
+struct SharedNetwork
+{
+	SharedNetworkHeader* header{ nullptr };
+	std::uint32_t* departures{ nullptr };
+	double* link_totals{ nullptr };
+	IntersectionReport* reports{ nullptr };
+	std::uint64_t* exited{ nullptr };
+
+	static std::size_t size_of(std::size_t intersections, std::size_t links, std::size_t partitions)
+	{
+		return offsets(intersections, links).exited + partitions * sizeof(std::uint64_t);
+	}
+
+	static SharedNetwork at(void* view, std::size_t intersections, std::size_t links)
+	{
+		const auto base = (char*)view;
+		const auto layout = offsets(intersections, links);
+
+		SharedNetwork shared;
+		shared.header = (SharedNetworkHeader*)base;
+		shared.departures = (std::uint32_t*)(base + layout.departures);
+		shared.link_totals = (double*)(base + layout.link_totals);
+		shared.reports = (IntersectionReport*)(base + layout.reports);
+		shared.exited = (std::uint64_t*)(base + layout.exited);
+		return shared;
+	}
+
+	static std::wstring event_name(const std::wstring& mapping, const wchar_t* purpose, std::size_t partition)
+	{
+		return mapping + L"-" + purpose + L"-" + std::to_wstring(partition);
+	}
+
+private:
+	struct Offsets
+	{
+		std::size_t departures;
+		std::size_t link_totals;
+		std::size_t reports;
+		std::size_t exited;
+	};
+
+	// Every array starts on its own cache line so workers filling neighbouring arrays do not contend.
+	static std::size_t aligned(std::size_t offset) { return (offset + 63) / 64 * 64; }
+
+	static Offsets offsets(std::size_t intersections, std::size_t links)
+	{
+		Offsets layout;
+		layout.departures = aligned(sizeof(SharedNetworkHeader));
+		layout.link_totals = aligned(layout.departures + links * sizeof(std::uint32_t));
+		layout.reports = aligned(layout.link_totals + links * sizeof(double));
+		layout.exited = aligned(layout.reports + intersections * sizeof(IntersectionReport));
+		return layout;
+	}
+};
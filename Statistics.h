@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+
+struct ConfidenceInterval
+{
+	double mean{ 0.0 };
+	double half_width{ 0.0 };
+	std::size_t samples{ 0 };
+};
+
+// Two sided 95% quantile of Student's t distribution.
+double student_t_95(std::size_t degrees_of_freedom)
+{
+	constexpr static double table[] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+	};
+	if (degrees_of_freedom == 0)
+		return INFINITY;
+	if (degrees_of_freedom <= sizeof(table) / sizeof(*table))
+		return table[degrees_of_freedom - 1];
+	return 1.960 + 2.4 / degrees_of_freedom;
+}
+
+ConfidenceInterval confidence_interval(const double* values, std::size_t count)
+{
+	ConfidenceInterval interval;
+	interval.samples = count;
+	if (count == 0)
+		return interval;
+
+	for (std::size_t i = 0; i < count; i++)
+		interval.mean += values[i];
+	interval.mean /= count;
+
+	if (count < 2) {
+		interval.half_width = INFINITY;
+		return interval;
+	}
+
+	auto variance = 0.0;
+	for (std::size_t i = 0; i < count; i++)
+		variance += (values[i] - interval.mean) * (values[i] - interval.mean);
+	variance /= count - 1;
+
+	interval.half_width = student_t_95(count - 1) * sqrt(variance / count);
+	return interval;
+}
+
+// Number of leading observations to discard as warm-up, by MSER-5: the series is averaged in batches of
+// five and the truncation point is the one minimising the squared standard error of what is left. Only the
+// first half of the series is considered, past that the statistic is too noisy to trust.
+std::size_t mser5_truncation(const std::vector<double>& series)
+{
+	constexpr std::size_t batch_size = 5;
+	const auto batches = series.size() / batch_size;
+	if (batches < 2)
+		return 0;
+
+	std::vector<double> means(batches, 0.0);
+	for (std::size_t batch = 0; batch < batches; batch++) {
+		for (std::size_t i = 0; i < batch_size; i++)
+			means[batch] += series[batch * batch_size + i];
+		means[batch] /= batch_size;
+	}
+
+	// Suffix sums make every candidate truncation O(1) to score.
+	std::vector<double> sum(batches + 1, 0.0);
+	std::vector<double> sum_of_squares(batches + 1, 0.0);
+	for (std::size_t batch = batches; batch-- > 0;) {
+		sum[batch] = sum[batch + 1] + means[batch];
+		sum_of_squares[batch] = sum_of_squares[batch + 1] + means[batch] * means[batch];
+	}
+
+	std::size_t best = 0;
+	auto best_score = INFINITY;
+	for (std::size_t truncated = 0; truncated <= batches / 2; truncated++) {
+		const auto remaining = (double)(batches - truncated);
+		const auto squared_deviations = sum_of_squares[truncated] - sum[truncated] * sum[truncated] / remaining;
+		const auto score = squared_deviations / (remaining * remaining);
+		if (score < best_score) {
+			best_score = score;
+			best = truncated;
+		}
+	}
+	return best * batch_size;
+}
+
+// Confidence interval on the mean of a correlated series, from the means of equally sized batches taken
+// from first onwards. Trailing observations that do not fill a batch are left out.
+ConfidenceInterval batch_means_interval(const std::vector<double>& series, std::size_t first, std::size_t batches)
+{
+	if (first >= series.size() || batches == 0)
+		return {};
+
+	const auto batch_size = (series.size() - first) / batches;
+	if (batch_size == 0)
+		return confidence_interval(series.data() + first, series.size() - first);
+
+	std::vector<double> means(batches, 0.0);
+	for (std::size_t batch = 0; batch < batches; batch++) {
+		for (std::size_t i = 0; i < batch_size; i++)
+			means[batch] += series[first + batch * batch_size + i];
+		means[batch] /= batch_size;
+	}
+	return confidence_interval(means.data(), batches);
+}
@@ -40,10 +40,6 @@ class TrafficLightDrawable : public TrafficLight
 {
 public:
 	TrafficLightDrawable();
-	~TrafficLightDrawable() {
-		DeleteObject(background_brush);
-		DeleteObject(dark_brush);
-	};
 
 	void draw(const HDC context) const;
 
@@ -69,13 +65,6 @@ private:
 	}
 
 private:
-	HBRUSH background_brush{ nullptr };
-	HBRUSH dark_brush{ nullptr };
-
-	HBRUSH red_brush{ nullptr };
-	HBRUSH yellow_brush{ nullptr };
-	HBRUSH green_brush{ nullptr };
-
 	POINT m_position{ 0, 0 };
 	SIZE m_size{ 10, 50 };
 
@@ -96,39 +85,29 @@ private:
 
 TrafficLightDrawable::TrafficLightDrawable()
 {
-	background_brush = CreateSolidBrush(black_color);
-	dark_brush = CreateSolidBrush(dark_color);
-	red_brush = CreateSolidBrush(red_color);
-	yellow_brush = CreateSolidBrush(yellow_color);
-	green_brush = CreateSolidBrush(green_color);
-
 	recalc_everything();
 }
 
 void TrafficLightDrawable::draw(const HDC context) const
 {
+	// Drawing goes through the DC brush so a light owns no GDI objects of its own.
+	const auto brush = (HBRUSH)GetStockObject(DC_BRUSH);
+
 	//left top right bottom
-	FillRect(context, &m_rect, background_brush);
+	SetDCBrushColor(context, black_color);
+	FillRect(context, &m_rect, brush);
 
-	if (state() == State::RED || state() == State::ALMOST_GREEN)
-		SelectObject(context, red_brush);
-	else
-		SelectObject(context, dark_brush);
+	SelectObject(context, brush);
+	SetDCBrushColor(context, (state() == State::RED || state() == State::ALMOST_GREEN) ? red_color : dark_color);
 
 	Ellipse(context, m_rect.left + m_circle1.left, m_rect.top + m_circle1.top, m_rect.left + m_circle1.right, m_rect.top + m_circle1.bottom);
 
 
-	if (state() == State::YELLOW || state() == State::ALMOST_GREEN)
-		SelectObject(context, yellow_brush);
-	else
-		SelectObject(context, dark_brush);
+	SetDCBrushColor(context, (state() == State::YELLOW || state() == State::ALMOST_GREEN) ? yellow_color : dark_color);
 
 	Ellipse(context, m_rect.left + m_circle2.left, m_rect.top + m_circle2.top, m_rect.left + m_circle2.right, m_rect.top + m_circle2.bottom);
 
-	if (state() == State::GREEN)
-		SelectObject(context, green_brush);
-	else
-		SelectObject(context, dark_brush);
+	SetDCBrushColor(context, state() == State::GREEN ? green_color : dark_color);
 
 	Ellipse(context, m_rect.left + m_circle3.left, m_rect.top + m_circle3.top, m_rect.left + m_circle3.right, m_rect.top + m_circle3.bottom);
 	
@@ -0,0 +1,440 @@
+// TrafficSimulation.cpp : Defines the exported functions of the DLL.
+//
+
+#include "framework.h"
+#include "TrafficSimulation.h"
+
+#include "Intersection.h"
+#include "Replication.h"
+#include "Comparison.h"
+#include "Network.h"
+#include "PartitionedNetwork.h"
+
+#include <new>
+#include <climits>
+
+struct traffic_simulation
+{
+    explicit traffic_simulation(uint32_t seed) : intersection(seed) {}
+
+    Intersection intersection;
+};
+
+// Exactly one of the two is set, depending on how the network was created.
+struct traffic_network
+{
+    std::unique_ptr<Network> network;
+    std::unique_ptr<PartitionedNetwork> partitioned;
+};
+
+static bool valid_approach(traffic_approach approach)
+{
+    return approach >= TRAFFIC_NORTH && approach < TRAFFIC_APPROACH_COUNT;
+}
+
+// The engine spawns at most one car per frame, with a chance of one in probability. Returns false if the
+// demand cannot be expressed that way, including demand so low that probability would not fit in an int.
+static bool probability_of(double vehicles_per_hour, int& probability)
+{
+    const auto frames_per_hour = 3600.0 * FPS;
+    if (!(vehicles_per_hour >= 0.0) || vehicles_per_hour > frames_per_hour)
+        return false;
+    if (vehicles_per_hour == 0.0) {
+        probability = 0;
+        return true;
+    }
+
+    const auto frames = frames_per_hour / vehicles_per_hour + 0.5;
+    if (frames >= (double)INT_MAX)
+        return false;
+    probability = max((int)frames, 1);
+    return true;
+}
+
+// TrafficWorker.exe is expected next to this DLL.
+static std::wstring default_worker_path()
+{
+    HMODULE module = nullptr;
+    if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)&default_worker_path, &module))
+        return L"TrafficWorker.exe";
+
+    WCHAR path[MAX_PATH]{ 0 };
+    const auto length = GetModuleFileNameW(module, path, MAX_PATH);
+    if (length == 0 || length == MAX_PATH)
+        return L"TrafficWorker.exe";
+
+    std::wstring directory = path;
+    directory.erase(directory.find_last_of(L"\\/") + 1);
+    return directory + L"TrafficWorker.exe";
+}
+
+static bool scenario_of(const traffic_scenario& in, Scenario& out)
+{
+    for (int approach = TRAFFIC_NORTH; approach < TRAFFIC_APPROACH_COUNT; approach++)
+        if (!probability_of(in.demand[approach], out.probability[approach]))
+            return false;
+    if (in.driving[TRAFFIC_NORTH_SOUTH] == 0 || in.driving[TRAFFIC_EAST_WEST] == 0)
+        return false;
+
+    out.north_south = { in.driving[TRAFFIC_NORTH_SOUTH], in.stopping[TRAFFIC_NORTH_SOUTH], in.starting[TRAFFIC_NORTH_SOUTH] };
+    out.east_west = { in.driving[TRAFFIC_EAST_WEST], in.stopping[TRAFFIC_EAST_WEST], in.starting[TRAFFIC_EAST_WEST] };
+    return true;
+}
+
+traffic_simulation* traffic_create(uint32_t seed)
+{
+    // Seeding and the density grid allocate in the constructor, so more than the new itself can throw.
+    try {
+        return new traffic_simulation(seed);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void traffic_destroy(traffic_simulation* simulation)
+{
+    delete simulation;
+}
+
+traffic_status traffic_seed(traffic_simulation* simulation, uint32_t seed)
+{
+    if (simulation == nullptr)
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    try {
+        simulation->intersection.seed(seed);
+    }
+    catch (const std::bad_alloc&) {
+        return TRAFFIC_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_set_demand(traffic_simulation* simulation, traffic_approach approach, double vehicles_per_hour)
+{
+    int probability;
+    if (simulation == nullptr || !valid_approach(approach) || !probability_of(vehicles_per_hour, probability))
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    simulation->intersection.set_probability((Direction)approach, probability);
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_set_signal_timing(traffic_simulation* simulation, traffic_axis axis, uint32_t driving, uint32_t stopping, uint32_t starting)
+{
+    if (simulation == nullptr || (axis != TRAFFIC_NORTH_SOUTH && axis != TRAFFIC_EAST_WEST) || driving == 0)
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    simulation->intersection.set_timing(axis == TRAFFIC_EAST_WEST ? Orientation::HORIZONTAL : Orientation::VERTICAL, { driving, stopping, starting });
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_step(traffic_simulation* simulation, uint32_t seconds)
+{
+    if (simulation == nullptr)
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    // Exceptions must not cross the C boundary.
+    try {
+        simulation->intersection.simulate(seconds);
+    }
+    catch (const std::bad_alloc&) {
+        return TRAFFIC_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_get_metrics(const traffic_simulation* simulation, traffic_metrics* metrics, size_t size)
+{
+    if (simulation == nullptr || metrics == nullptr)
+        return TRAFFIC_INVALID_ARGUMENT;
+    if (size < sizeof(double))
+        return TRAFFIC_BUFFER_TOO_SMALL;
+
+    const auto& intersection = simulation->intersection;
+
+    traffic_metrics result{};
+    result.simulated_seconds = intersection.time();
+    for (int approach = TRAFFIC_NORTH; approach < TRAFFIC_APPROACH_COUNT; approach++) {
+        const auto& metrics_of = intersection.metrics((Direction)approach);
+        auto& out = result.approaches[approach];
+        out.spawned = metrics_of.spawned;
+        out.completed = metrics_of.completed;
+        out.cars = intersection.cars((Direction)approach);
+        out.queued = intersection.queued((Direction)approach);
+        out.travel_time = metrics_of.travel_time;
+        out.delay = metrics_of.delay;
+    }
+
+    memcpy(metrics, &result, min(size, sizeof(result)));
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_get_density(const traffic_simulation* simulation, traffic_density_cell* cells, size_t count, uint32_t* columns, uint32_t* rows, uint32_t* cell_size)
+{
+    if (simulation == nullptr || (cells == nullptr && count != 0))
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    const auto& density = simulation->intersection.density();
+    if (columns != nullptr)
+        *columns = (uint32_t)density.columns();
+    if (rows != nullptr)
+        *rows = (uint32_t)density.rows();
+    if (cell_size != nullptr)
+        *cell_size = (uint32_t)density.cell_size();
+    if (count < density.columns() * density.rows())
+        return TRAFFIC_BUFFER_TOO_SMALL;
+
+    for (std::size_t row = 0; row < density.rows(); row++) {
+        for (std::size_t column = 0; column < density.columns(); column++) {
+            auto& cell = cells[row * density.columns() + column];
+            cell.occupancy = density.occupancy(column, row);
+            cell.mean_speed = density.mean_speed(column, row);
+        }
+    }
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_clear_density(traffic_simulation* simulation)
+{
+    if (simulation == nullptr)
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    simulation->intersection.clear_density();
+    return TRAFFIC_OK;
+}
+
+void traffic_default_replication_options(traffic_replication_options* options)
+{
+    if (options == nullptr)
+        return;
+
+    const ReplicationOptions defaults;
+    options->max_seconds = (uint32_t)defaults.max_seconds;
+    options->check_seconds = (uint32_t)defaults.check_seconds;
+    options->target_half_width = defaults.target_half_width;
+    options->batches = (uint32_t)defaults.batches;
+    options->min_batch_size = (uint32_t)defaults.min_batch_size;
+}
+
+traffic_status traffic_run_replication(traffic_simulation* simulation, const traffic_replication_options* options, traffic_replication_result* result, size_t size)
+{
+    if (simulation == nullptr || result == nullptr)
+        return TRAFFIC_INVALID_ARGUMENT;
+    if (size < sizeof(double))
+        return TRAFFIC_BUFFER_TOO_SMALL;
+
+    ReplicationOptions replication;
+    if (options != nullptr) {
+        if (!(options->target_half_width > 0.0) || options->batches < 2 || options->min_batch_size < 1)
+            return TRAFFIC_INVALID_ARGUMENT;
+        replication.max_seconds = options->max_seconds;
+        replication.check_seconds = options->check_seconds;
+        replication.target_half_width = options->target_half_width;
+        replication.batches = options->batches;
+        replication.min_batch_size = options->min_batch_size;
+    }
+
+    ReplicationResult outcome;
+    try {
+        outcome = run_replication(simulation->intersection, replication);
+    }
+    catch (const std::bad_alloc&) {
+        return TRAFFIC_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+
+    traffic_replication_result copy{};
+    copy.simulated_seconds = (double)outcome.seconds;
+    copy.warmup_seconds = outcome.warmup_seconds;
+    copy.warmup_cars = outcome.warmup_cars;
+    copy.cars = outcome.cars;
+    copy.mean_delay = outcome.delay.mean;
+    copy.half_width = outcome.delay.half_width;
+    copy.converged = outcome.converged ? 1 : 0;
+
+    memcpy(result, &copy, min(size, sizeof(copy)));
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_compare(const traffic_scenario* a, const traffic_scenario* b, const traffic_comparison_options* options, traffic_comparison_result* result, size_t size)
+{
+    Scenario scenario_a;
+    Scenario scenario_b;
+    if (a == nullptr || b == nullptr || options == nullptr || result == nullptr || options->replications < 2)
+        return TRAFFIC_INVALID_ARGUMENT;
+    if (size < sizeof(double))
+        return TRAFFIC_BUFFER_TOO_SMALL;
+    if (!scenario_of(*a, scenario_a) || !scenario_of(*b, scenario_b))
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    ComparisonOptions comparison;
+    comparison.replications = options->replications;
+    comparison.seconds = options->seconds;
+    comparison.seed = options->seed;
+    comparison.antithetic = options->antithetic != 0;
+
+    ComparisonResult outcome;
+    try {
+        outcome = compare_scenarios(scenario_a, scenario_b, comparison);
+    }
+    catch (const std::bad_alloc&) {
+        return TRAFFIC_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+
+    traffic_comparison_result copy{};
+    copy.mean_delay_a = outcome.a.mean;
+    copy.half_width_a = outcome.a.half_width;
+    copy.mean_delay_b = outcome.b.mean;
+    copy.half_width_b = outcome.b.half_width;
+    copy.mean_difference = outcome.difference.mean;
+    copy.half_width_difference = outcome.difference.half_width;
+    copy.samples = outcome.difference.samples;
+
+    memcpy(result, &copy, min(size, sizeof(copy)));
+    return TRAFFIC_OK;
+}
+
+traffic_network* traffic_network_create(uint32_t rows, uint32_t columns, uint32_t link_cells, uint32_t seed)
+{
+    if (rows == 0 || columns == 0 || link_cells == 0)
+        return nullptr;
+
+    std::unique_ptr<traffic_network> network;
+    try {
+        network = std::make_unique<traffic_network>();
+        network->network = std::make_unique<Network>(rows, columns, link_cells, seed);
+    }
+    catch (...) {
+        return nullptr;
+    }
+    return network.release();
+}
+
+traffic_network* traffic_network_create_partitioned(uint32_t rows, uint32_t columns, uint32_t link_cells, uint32_t seed, uint32_t partitions, const wchar_t* worker_path)
+{
+    if (rows == 0 || columns == 0 || link_cells == 0 || partitions == 0)
+        return nullptr;
+
+    std::unique_ptr<traffic_network> network;
+    try {
+        network = std::make_unique<traffic_network>();
+        network->partitioned = std::make_unique<PartitionedNetwork>(rows, columns, link_cells, seed, partitions, worker_path != nullptr ? std::wstring(worker_path) : default_worker_path());
+    }
+    catch (...) {
+        return nullptr;
+    }
+    return network.release();
+}
+
+void traffic_network_destroy(traffic_network* network)
+{
+    delete network;
+}
+
+traffic_status traffic_network_set_demand(traffic_network* network, double vehicles_per_hour)
+{
+    int probability;
+    if (network == nullptr || !probability_of(vehicles_per_hour, probability))
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    try {
+        if (network->partitioned != nullptr)
+            network->partitioned->set_boundary_probability(probability);
+        else
+            network->network->set_boundary_probability(probability);
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_network_set_signal_timing(traffic_network* network, traffic_axis axis, uint32_t driving, uint32_t stopping, uint32_t starting)
+{
+    if (network == nullptr || (axis != TRAFFIC_NORTH_SOUTH && axis != TRAFFIC_EAST_WEST) || driving == 0)
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    const auto orientation = axis == TRAFFIC_EAST_WEST ? Orientation::HORIZONTAL : Orientation::VERTICAL;
+    try {
+        if (network->partitioned != nullptr)
+            network->partitioned->set_timing(orientation, { driving, stopping, starting });
+        else
+            network->network->set_timing(orientation, { driving, stopping, starting });
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_network_step(traffic_network* network, uint32_t seconds)
+{
+    if (network == nullptr)
+        return TRAFFIC_INVALID_ARGUMENT;
+
+    try {
+        if (network->partitioned != nullptr)
+            network->partitioned->simulate(seconds);
+        else
+            network->network->simulate(seconds);
+    }
+    catch (const std::bad_alloc&) {
+        return TRAFFIC_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+    return TRAFFIC_OK;
+}
+
+traffic_status traffic_network_get_metrics(traffic_network* network, traffic_network_metrics* metrics, size_t size)
+{
+    if (network == nullptr || metrics == nullptr)
+        return TRAFFIC_INVALID_ARGUMENT;
+    if (size < sizeof(double))
+        return TRAFFIC_BUFFER_TOO_SMALL;
+
+    NetworkReport report;
+    traffic_network_metrics result{};
+    try {
+        if (network->partitioned != nullptr) {
+            report = network->partitioned->report();
+            result.simulated_seconds = (double)network->partitioned->seconds();
+            result.intersections = network->partitioned->intersections();
+        }
+        else {
+            report = network->network->report();
+            result.simulated_seconds = (double)network->network->seconds();
+            result.intersections = network->network->intersections();
+        }
+    }
+    catch (const std::bad_alloc&) {
+        return TRAFFIC_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return TRAFFIC_INTERNAL_ERROR;
+    }
+
+    result.spawned = report.spawned;
+    result.exited = report.exited;
+    result.in_intersections = report.in_intersections;
+    result.on_links = report.on_links;
+    result.delay = report.delay;
+    result.completed = report.completed;
+
+    memcpy(metrics, &result, min(size, sizeof(result)));
+    return TRAFFIC_OK;
+}
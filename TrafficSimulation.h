@@ -0,0 +1,198 @@
+// TrafficSimulation.h : C interface to the intersection engine, exported by TrafficSimulation.dll.
+//
+// Every function takes the simulation it works on, nothing is shared between simulations, so
+// independent simulations may be created and stepped from different threads at the same time.
+// A single simulation must not be used from more than one thread at once.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#ifdef TRAFFIC_SIMULATION_EXPORTS
+#define TRAFFIC_SIMULATION_API __declspec(dllexport)
+#else
+#define TRAFFIC_SIMULATION_API __declspec(dllimport)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct traffic_simulation traffic_simulation;
+typedef struct traffic_network traffic_network;
+
+typedef enum traffic_status
+{
+	TRAFFIC_OK = 0,
+	TRAFFIC_INVALID_ARGUMENT = 1,
+	TRAFFIC_OUT_OF_MEMORY = 2,
+	TRAFFIC_BUFFER_TOO_SMALL = 3,
+	TRAFFIC_INTERNAL_ERROR = 4,
+} traffic_status;
+
+// Values match the engine's Direction, the side of the intersection traffic approaches from.
+typedef enum traffic_approach
+{
+	TRAFFIC_NORTH = 0,
+	TRAFFIC_EAST = 1,
+	TRAFFIC_SOUTH = 2,
+	TRAFFIC_WEST = 3,
+	TRAFFIC_APPROACH_COUNT = 4,
+} traffic_approach;
+
+typedef enum traffic_axis
+{
+	TRAFFIC_NORTH_SOUTH = 0,
+	TRAFFIC_EAST_WEST = 1,
+} traffic_axis;
+
+typedef struct traffic_approach_metrics
+{
+	uint64_t spawned;
+	uint64_t completed;
+	uint64_t cars;			// currently on the approach or in the junction
+	uint64_t queued;		// standing still short of the stop line
+	double travel_time;		// summed over completed cars, in seconds
+	double delay;			// summed over completed cars, in seconds lost against driving at full speed
+} traffic_approach_metrics;
+
+typedef struct traffic_metrics
+{
+	double simulated_seconds;
+	traffic_approach_metrics approaches[TRAFFIC_APPROACH_COUNT];
+} traffic_metrics;
+
+typedef struct traffic_density_cell
+{
+	double occupancy;				// mean number of cars with their centre in the cell
+	double mean_speed;				// of those cars, in pixels per second; zero if none was seen
+} traffic_density_cell;
+
+typedef struct traffic_replication_options
+{
+	uint32_t max_seconds;			// hard limit on the length of the run
+	uint32_t check_seconds;			// how often warm-up and convergence are re-evaluated
+	double target_half_width;		// stop once the 95% interval on mean delay is this narrow, in seconds
+	uint32_t batches;				// batch means used for the interval
+	uint32_t min_batch_size;		// completed cars per batch needed before the interval is trusted, at least 1
+} traffic_replication_options;
+
+typedef struct traffic_replication_result
+{
+	double simulated_seconds;
+	double warmup_seconds;			// simulated time discarded as warm-up
+	uint64_t warmup_cars;			// completed cars discarded as warm-up
+	uint64_t cars;					// completed cars the estimate is based on
+	double mean_delay;				// per car, in seconds
+	double half_width;				// of the 95% confidence interval on mean_delay
+	int32_t converged;				// nonzero if half_width reached the target before max_seconds
+} traffic_replication_result;
+
+typedef struct traffic_scenario
+{
+	double demand[TRAFFIC_APPROACH_COUNT];		// vehicles per hour, indexed by traffic_approach
+	uint32_t driving[2];						// signal timing in seconds, indexed by traffic_axis
+	uint32_t stopping[2];
+	uint32_t starting[2];
+} traffic_scenario;
+
+typedef struct traffic_comparison_options
+{
+	uint32_t replications;
+	uint32_t seconds;				// simulated per replication, warm-up included
+	uint32_t seed;
+	int32_t antithetic;				// nonzero to pair every replication with its antithetic run
+} traffic_comparison_options;
+
+typedef struct traffic_comparison_result
+{
+	// Mean delay per car, in seconds, with the half width of its 95% confidence interval.
+	double mean_delay_a;
+	double half_width_a;
+	double mean_delay_b;
+	double half_width_b;
+	// Paired difference b - a.
+	double mean_difference;
+	double half_width_difference;
+	uint64_t samples;
+} traffic_comparison_result;
+
+typedef struct traffic_network_metrics
+{
+	double simulated_seconds;
+	uint64_t intersections;
+	uint64_t spawned;				// cars that arrived on an approach at the edge of the grid
+	uint64_t exited;				// cars that left by an edge of the grid
+	uint64_t in_intersections;		// cars simulated individually right now, or waiting to enter from a link
+	double on_links;				// vehicles carried as flow on the roads between intersections
+	double delay;					// summed over cars completing any intersection, in seconds
+	uint64_t completed;				// intersection passages the delay is summed over
+} traffic_network_metrics;
+
+// Returns nullptr if the simulation could not be allocated.
+TRAFFIC_SIMULATION_API traffic_simulation* traffic_create(uint32_t seed);
+TRAFFIC_SIMULATION_API void traffic_destroy(traffic_simulation* simulation);
+
+TRAFFIC_SIMULATION_API traffic_status traffic_seed(traffic_simulation* simulation, uint32_t seed);
+
+// Arrivals on one approach in vehicles per hour. Zero turns the approach off. Demand above one car per frame,
+// or so low that a car would be due less than once in INT_MAX frames, is TRAFFIC_INVALID_ARGUMENT.
+TRAFFIC_SIMULATION_API traffic_status traffic_set_demand(traffic_simulation* simulation, traffic_approach approach, double vehicles_per_hour);
+
+// Seconds of green, yellow and red-and-yellow for both approaches on an axis.
+TRAFFIC_SIMULATION_API traffic_status traffic_set_signal_timing(traffic_simulation* simulation, traffic_axis axis, uint32_t driving, uint32_t stopping, uint32_t starting);
+
+TRAFFIC_SIMULATION_API traffic_status traffic_step(traffic_simulation* simulation, uint32_t seconds);
+
+// Copies the metrics into a caller-owned buffer of size bytes. Fields are only ever appended to the end of
+// traffic_metrics, so a caller built against an older header gets the prefix it knows about.
+TRAFFIC_SIMULATION_API traffic_status traffic_get_metrics(const traffic_simulation* simulation, traffic_metrics* metrics, size_t size);
+
+// Copies the density grid accumulated over the roads since creation or the last traffic_clear_density into a
+// caller-owned array of count cells, row by row from the north-west corner. columns, rows and cell_size (in
+// pixels) are filled in whenever they are not nullptr, so calling with cells nullptr and count 0 returns
+// TRAFFIC_BUFFER_TOO_SMALL along with the size to allocate.
+TRAFFIC_SIMULATION_API traffic_status traffic_get_density(const traffic_simulation* simulation, traffic_density_cell* cells, size_t count, uint32_t* columns, uint32_t* rows, uint32_t* cell_size);
+
+// Starts accumulating the density grid afresh, for example once the warm-up is over.
+TRAFFIC_SIMULATION_API traffic_status traffic_clear_density(traffic_simulation* simulation);
+
+// Fills options with the defaults used when traffic_run_replication is given nullptr.
+TRAFFIC_SIMULATION_API void traffic_default_replication_options(traffic_replication_options* options);
+
+// Runs the simulation until mean delay has converged, with the warm-up transient detected by MSER-5 and
+// left out. Meant for a freshly created simulation, which starts with empty roads. The result is copied
+// into a buffer of size bytes, versioned like traffic_metrics.
+// Only the result leaves the warm-up out. The truncation point is found after the fact, so the counters read
+// back by traffic_get_metrics still cover the whole run from creation, warm-up cars included.
+TRAFFIC_SIMULATION_API traffic_status traffic_run_replication(traffic_simulation* simulation, const traffic_replication_options* options, traffic_replication_result* result, size_t size);
+
+// Runs both scenarios on common random numbers for arrivals and car placement, optionally with antithetic
+// pairs, and reports the paired difference in mean delay. Needs no simulation handle. The result is copied
+// into a buffer of size bytes, versioned like traffic_metrics.
+TRAFFIC_SIMULATION_API traffic_status traffic_compare(const traffic_scenario* a, const traffic_scenario* b, const traffic_comparison_options* options, traffic_comparison_result* result, size_t size);
+
+// A rows by columns grid of intersections joined by cell transmission roads link_cells cells long. Cars are
+// simulated individually inside the intersections and as flow on the roads between them.
+TRAFFIC_SIMULATION_API traffic_network* traffic_network_create(uint32_t rows, uint32_t columns, uint32_t link_cells, uint32_t seed);
+
+// The same network split into partitions of whole rows, each simulated by a TrafficWorker process pinned to
+// a NUMA node, exchanging the cars that cross partitions once per step through shared memory. Results are
+// bitwise identical to traffic_network_create with the same arguments, whatever the number of partitions.
+// worker_path may be nullptr to use the TrafficWorker.exe next to this DLL. Returns nullptr if the network
+// could not be created or a worker failed to start.
+TRAFFIC_SIMULATION_API traffic_network* traffic_network_create_partitioned(uint32_t rows, uint32_t columns, uint32_t link_cells, uint32_t seed, uint32_t partitions, const wchar_t* worker_path);
+TRAFFIC_SIMULATION_API void traffic_network_destroy(traffic_network* network);
+
+// Demand on every approach at the edge of the grid, in vehicles per hour.
+TRAFFIC_SIMULATION_API traffic_status traffic_network_set_demand(traffic_network* network, double vehicles_per_hour);
+TRAFFIC_SIMULATION_API traffic_status traffic_network_set_signal_timing(traffic_network* network, traffic_axis axis, uint32_t driving, uint32_t stopping, uint32_t starting);
+TRAFFIC_SIMULATION_API traffic_status traffic_network_step(traffic_network* network, uint32_t seconds);
+TRAFFIC_SIMULATION_API traffic_status traffic_network_get_metrics(traffic_network* network, traffic_network_metrics* metrics, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
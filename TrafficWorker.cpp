@@ -0,0 +1,78 @@
+// TrafficWorker.cpp : Simulates one partition of a PartitionedNetwork on behalf of its host process.
+//
+// Usage: TrafficWorker <shared memory name> <partition> <NUMA node>
+//
+
+#include "framework.h"
+
+#include "SharedNetwork.h"
+
+// Keeps this thread, and so the memory it touches first, on one NUMA node.
+static void pin_to_node(USHORT node)
+{
+    GROUP_AFFINITY affinity{};
+    if (GetNumaNodeProcessorMaskEx(node, &affinity) && affinity.Mask != 0)
+        SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    if (argc != 4)
+        return 1;
+
+    const std::wstring name = argv[1];
+    const auto partition = (std::size_t)_wtoi(argv[2]);
+    pin_to_node((USHORT)_wtoi(argv[3]));
+
+    const auto mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (mapping == nullptr)
+        return 2;
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (view == nullptr)
+        return 2;
+
+    const auto& header = *(const SharedNetworkHeader*)view;
+    const auto shared = SharedNetwork::at(view, (std::size_t)header.rows * header.columns, header.links);
+
+    const auto go = OpenEventW(SYNCHRONIZE, FALSE, SharedNetwork::event_name(name, L"go", partition).c_str());
+    const auto done = OpenEventW(EVENT_MODIFY_STATE, FALSE, SharedNetwork::event_name(name, L"done", partition).c_str());
+    if (go == nullptr || done == nullptr)
+        return 3;
+
+    Network network(header.rows, header.columns, header.link_cells, header.seed, partition, header.partitions);
+    SetEvent(done);
+
+    for (;;)
+    {
+        WaitForSingleObject(go, INFINITE);
+
+        switch (header.command)
+        {
+        case WorkerCommand::STEP_INTERSECTIONS:
+            network.step_intersections(shared.departures);
+            break;
+        case WorkerCommand::STEP_LINKS:
+            network.step_links(shared.departures);
+            break;
+        case WorkerCommand::SET_DEMAND:
+            network.set_boundary_probability(header.probability);
+            break;
+        case WorkerCommand::SET_TIMING:
+            network.set_timing((Orientation)header.axis, { header.driving, header.stopping, header.starting });
+            break;
+        case WorkerCommand::REPORT:
+            for (std::size_t index = 0; index < network.intersections(); index++)
+                if (network.owns(index))
+                    shared.reports[index] = network.report(index);
+            for (const auto& link : network.links())
+                shared.link_totals[link.id] = Network::total_of(link);
+            shared.exited[partition] = network.exited();
+            break;
+        case WorkerCommand::EXIT:
+            SetEvent(done);
+            return 0;
+        }
+
+        SetEvent(done);
+    }
+}